@@ -0,0 +1,586 @@
+#include "batch_world.hpp"
+#include "utils.hpp"
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr size_t L = BATCH_LANES;
+
+BatchTerrain BuildBatchTerrain(const Level &level, float minX, float maxX, float spacing)
+{
+    BatchTerrain terrain;
+    terrain.minX = minX;
+    terrain.spacing = spacing;
+    size_t count = size_t(std::max(1.0f, std::ceil((maxX - minX) / spacing))) + 1;
+    terrain.heights.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        terrain.heights[i] = level.GetHeight(minX + float(i) * spacing);
+    return terrain;
+}
+
+// Kernels below take the block's [point][lane] arrays; point i of lane l is at i * L + l.
+// Inverse masses and constraints are shared by all lanes, so branches on them are uniform.
+
+static void SolveDistanceLanes(float *X, float *Y, const float *inverseMasses, const DistanceConstraint *constraints, size_t count, float *lambdas, float dt)
+{
+    for (size_t ci = 0; ci < count; ++ci, lambdas += L)
+    {
+        const DistanceConstraint &c = constraints[ci];
+        float w1 = inverseMasses[c.i1];
+        float w2 = inverseMasses[c.i2];
+        float alphaTilde = c.compliance / (dt * dt);
+        float denom = w1 + w2 + alphaTilde;
+        if (denom < 1e-6f)
+            continue;
+
+        float *x1 = X + c.i1 * L, *y1 = Y + c.i1 * L;
+        float *x2 = X + c.i2 * L, *y2 = Y + c.i2 * L;
+        for (size_t l = 0; l < L; ++l)
+        {
+            float dx = x1[l] - x2[l];
+            float dy = y1[l] - y2[l];
+            float len = std::sqrt(dx * dx + dy * dy);
+            float invLen = len < 1e-6f ? 0.0f : 1.0f / len;
+            float dl = len < 1e-6f ? 0.0f : (-(len - c.restDistance) - alphaTilde * lambdas[l]) / denom;
+            lambdas[l] += dl;
+            x1[l] += w1 * dl * dx * invLen;
+            y1[l] += w1 * dl * dy * invLen;
+            x2[l] -= w2 * dl * dx * invLen;
+            y2[l] -= w2 * dl * dy * invLen;
+        }
+    }
+}
+
+static void SolveVolumeLanes(float *X, float *Y, const float *inverseMasses, const VolumeConstraint *constraints, size_t count, const uint32_t *indexPool, float *lambdas, float *scratch, float dt)
+{
+    for (size_t ci = 0; ci < count; ++ci, lambdas += L)
+    {
+        const VolumeConstraint &c = constraints[ci];
+        const uint32_t *indices = indexPool + c.indices.begin;
+        size_t N = c.indices.count;
+        if (N < 3)
+            continue;
+
+        // pre-correction ring, gradients must not see points already moved in this pass
+        float *sx = scratch;
+        float *sy = scratch + N * L;
+        for (size_t i = 0; i < N; ++i)
+        {
+            std::copy(X + indices[i] * L, X + indices[i] * L + L, sx + i * L);
+            std::copy(Y + indices[i] * L, Y + indices[i] * L + L, sy + i * L);
+        }
+
+        float area[L] = {}, denom[L] = {};
+        for (size_t i = 0; i < N; ++i)
+        {
+            const float *px = sx + (i == 0 ? N - 1 : i - 1) * L, *py = sy + (i == 0 ? N - 1 : i - 1) * L;
+            const float *cx = sx + i * L, *cy = sy + i * L;
+            const float *nx = sx + (i + 1 < N ? i + 1 : 0) * L, *ny = sy + (i + 1 < N ? i + 1 : 0) * L;
+            float w = inverseMasses[indices[i]];
+            for (size_t l = 0; l < L; ++l)
+            {
+                float gx = 0.5f * (ny[l] - py[l]);
+                float gy = 0.5f * (px[l] - nx[l]);
+                area[l] += cx[l] * ny[l] - cy[l] * nx[l];
+                denom[l] += w * (gx * gx + gy * gy);
+            }
+        }
+
+        float alphaTilde = c.compliance / (dt * dt);
+        float dl[L];
+        for (size_t l = 0; l < L; ++l)
+        {
+            float d = denom[l] + alphaTilde;
+            dl[l] = d < 1e-6f ? 0.0f : (-(0.5f * area[l] - c.restVolume) - alphaTilde * lambdas[l]) / d;
+            lambdas[l] += dl[l];
+        }
+
+        for (size_t i = 0; i < N; ++i)
+        {
+            const float *px = sx + (i == 0 ? N - 1 : i - 1) * L, *py = sy + (i == 0 ? N - 1 : i - 1) * L;
+            const float *nx = sx + (i + 1 < N ? i + 1 : 0) * L, *ny = sy + (i + 1 < N ? i + 1 : 0) * L;
+            float w = inverseMasses[indices[i]];
+            float *x = X + indices[i] * L, *y = Y + indices[i] * L;
+            for (size_t l = 0; l < L; ++l)
+            {
+                x[l] += w * dl[l] * 0.5f * (ny[l] - py[l]);
+                y[l] += w * dl[l] * 0.5f * (px[l] - nx[l]);
+            }
+        }
+    }
+}
+
+static void SolveAngleLanes(float *X, float *Y, const float *inverseMasses, const AngleConstraint *constraints, size_t count, float *lambdas, float dt)
+{
+    for (size_t ci = 0; ci < count; ++ci, lambdas += L)
+    {
+        const AngleConstraint &c = constraints[ci];
+        float w1 = inverseMasses[c.i1], w2 = inverseMasses[c.i2], w3 = inverseMasses[c.i3];
+        float alphaTilde = c.compliance / (dt * dt);
+        float *x1 = X + c.i1 * L, *y1 = Y + c.i1 * L;
+        float *x2 = X + c.i2 * L, *y2 = Y + c.i2 * L;
+        float *x3 = X + c.i3 * L, *y3 = Y + c.i3 * L;
+
+        for (size_t l = 0; l < L; ++l)
+        {
+            float ax = x1[l] - x2[l], ay = y1[l] - y2[l];
+            float bx = x3[l] - x2[l], by = y3[l] - y2[l];
+            float dot = ax * bx + ay * by;
+            float cross = ax * by - ay * bx;
+            float C = FastAtan2(cross * c.restRotation.x - dot * c.restRotation.y, dot * c.restRotation.x + cross * c.restRotation.y);
+
+            float la2 = ax * ax + ay * ay;
+            float lb2 = bx * bx + by * by;
+            float invLa2 = la2 > 1e-12f ? 1.0f / la2 : 0.0f;
+            float invLb2 = lb2 > 1e-12f ? 1.0f / lb2 : 0.0f;
+            float g1x = ay * invLa2, g1y = -ax * invLa2;
+            float g3x = -by * invLb2, g3y = bx * invLb2;
+            float g2x = -(g1x + g3x), g2y = -(g1y + g3y);
+
+            float denom = w1 * invLa2 + w2 * (g2x * g2x + g2y * g2y) + w3 * invLb2 + alphaTilde;
+            float valid = (invLa2 > 0.0f && invLb2 > 0.0f && denom > 1e-12f) ? 1.0f : 0.0f;
+            float dl = valid * (-C - alphaTilde * lambdas[l]) / (denom > 1e-12f ? denom : 1.0f);
+            lambdas[l] += dl;
+
+            x1[l] += w1 * dl * g1x;
+            y1[l] += w1 * dl * g1y;
+            x2[l] += w2 * dl * g2x;
+            y2[l] += w2 * dl * g2y;
+            x3[l] += w3 * dl * g3x;
+            y3[l] += w3 * dl * g3y;
+        }
+    }
+}
+
+static void SolveShapeMatchingLanes(float *X, float *Y, const float *inverseMasses, const ShapeMatchingConstraint *constraints, size_t count,
+                                    const uint32_t *indexPool, const glm::vec2 *restOffsetPool, float *lambdas, float dt)
+{
+    for (size_t ci = 0; ci < count; ++ci, lambdas += L)
+    {
+        const ShapeMatchingConstraint &c = constraints[ci];
+        const uint32_t *indices = indexPool + c.indices.begin;
+        const glm::vec2 *restOffsets = restOffsetPool + c.restOffsetsBegin;
+        size_t N = c.indices.count;
+        if (N < 2)
+            continue;
+
+        float cx[L] = {}, cy[L] = {};
+        for (size_t i = 0; i < N; ++i)
+        {
+            const float *x = X + indices[i] * L, *y = Y + indices[i] * L;
+            for (size_t l = 0; l < L; ++l)
+            {
+                cx[l] += x[l];
+                cy[l] += y[l];
+            }
+        }
+        for (size_t l = 0; l < L; ++l)
+        {
+            cx[l] /= float(N);
+            cy[l] /= float(N);
+        }
+
+        float a00[L] = {}, a01[L] = {}, a10[L] = {}, a11[L] = {};
+        for (size_t i = 0; i < N; ++i)
+        {
+            const float *x = X + indices[i] * L, *y = Y + indices[i] * L;
+            const glm::vec2 &q = restOffsets[i];
+            for (size_t l = 0; l < L; ++l)
+            {
+                float px = x[l] - cx[l], py = y[l] - cy[l];
+                a00[l] += px * q.x;
+                a01[l] += px * q.y;
+                a10[l] += py * q.x;
+                a11[l] += py * q.y;
+            }
+        }
+
+        // goal transform per lane, same polar decomposition and linearity blend as the scalar solver
+        float t00[L], t01[L], t10[L], t11[L];
+        for (size_t l = 0; l < L; ++l)
+        {
+            float cosR = a00[l] + a11[l];
+            float sinR = a10[l] - a01[l];
+            float len = std::sqrt(cosR * cosR + sinR * sinR);
+            cosR = len < 1e-6f ? 1.0f : cosR / len;
+            sinR = len < 1e-6f ? 0.0f : sinR / len;
+
+            glm::mat2 T(cosR, sinR, -sinR, cosR);
+            if (c.linearity > 0.0f)
+            {
+                glm::mat2 A = glm::mat2(a00[l], a10[l], a01[l], a11[l]) * c.restAqqInverse;
+                float det = glm::determinant(A);
+                if (det > 1e-6f)
+                    A /= std::sqrt(det);
+                T = c.linearity * A + (1.0f - c.linearity) * T;
+            }
+            t00[l] = T[0][0];
+            t10[l] = T[0][1];
+            t01[l] = T[1][0];
+            t11[l] = T[1][1];
+        }
+
+        float C2[L] = {}, denom[L] = {};
+        for (size_t i = 0; i < N; ++i)
+        {
+            const float *x = X + indices[i] * L, *y = Y + indices[i] * L;
+            const glm::vec2 &q = restOffsets[i];
+            float w = inverseMasses[indices[i]];
+            for (size_t l = 0; l < L; ++l)
+            {
+                float dx = x[l] - (t00[l] * q.x + t01[l] * q.y + cx[l]);
+                float dy = y[l] - (t10[l] * q.x + t11[l] * q.y + cy[l]);
+                float d2 = dx * dx + dy * dy;
+                C2[l] += d2;
+                denom[l] += w * d2;
+            }
+        }
+
+        float alphaTilde = c.compliance / (dt * dt);
+        float scale[L];
+        for (size_t l = 0; l < L; ++l)
+        {
+            float C = std::sqrt(C2[l]);
+            float d = C2[l] < 1e-12f ? 0.0f : denom[l] / C2[l] + alphaTilde;
+            float dl = d < 1e-6f ? 0.0f : (-C - alphaTilde * lambdas[l]) / d;
+            lambdas[l] += dl;
+            scale[l] = C2[l] < 1e-12f ? 0.0f : dl / C;
+        }
+
+        for (size_t i = 0; i < N; ++i)
+        {
+            float *x = X + indices[i] * L, *y = Y + indices[i] * L;
+            const glm::vec2 &q = restOffsets[i];
+            float w = inverseMasses[indices[i]];
+            for (size_t l = 0; l < L; ++l)
+            {
+                float dx = x[l] - (t00[l] * q.x + t01[l] * q.y + cx[l]);
+                float dy = y[l] - (t10[l] * q.x + t11[l] * q.y + cy[l]);
+                x[l] += w * scale[l] * dx;
+                y[l] += w * scale[l] * dy;
+            }
+        }
+    }
+}
+
+static void SolvePinLanes(float *X, float *Y, const float *inverseMasses, const PinConstraint *constraints, size_t count, float *lambdas, float dt)
+{
+    for (size_t ci = 0; ci < count; ++ci, lambdas += L)
+    {
+        const PinConstraint &c = constraints[ci];
+        float w = inverseMasses[c.index];
+        if (w == 0.0f)
+            continue;
+
+        float alphaTilde = c.compliance / (dt * dt);
+        float *x = X + c.index * L, *y = Y + c.index * L;
+        for (size_t l = 0; l < L; ++l)
+        {
+            float gx = c.targetPosition.x - x[l];
+            float gy = c.targetPosition.y - y[l];
+            float C = std::sqrt(gx * gx + gy * gy);
+            float invC = C < 1e-6f ? 0.0f : 1.0f / C;
+            float dl = (C < 1e-6f ? 0.0f : -C - alphaTilde * lambdas[l]) / (w + alphaTilde);
+            lambdas[l] += dl;
+            x[l] -= w * dl * gx * invC;
+            y[l] -= w * dl * gy * invC;
+        }
+    }
+}
+
+BatchWorld::BatchWorld(size_t worldCount)
+    : mWorldCount(worldCount), mBlockCount((worldCount + L - 1) / L)
+{
+}
+
+uint32_t BatchWorld::AddBody(const SoftBody &prototype)
+{
+    const SoftBodyTemplate &topology = *prototype.topology;
+    const PointMasses &pm = prototype.pointMasses;
+    uint32_t first = uint32_t(mPointCount);
+    uint32_t poolBegin = uint32_t(mIndexPool.size());
+    uint32_t restOffsetsBegin = uint32_t(mRestOffsetPool.size());
+
+    mBodies.push_back({first, uint32_t(pm.positions.size())});
+    mPointCount += pm.positions.size();
+    mInitialPositions.insert(mInitialPositions.end(), pm.positions.begin(), pm.positions.end());
+    mInverseMasses.insert(mInverseMasses.end(), pm.inverseMasses.begin(), pm.inverseMasses.end());
+
+    for (auto c : topology.distanceConstraints)
+    {
+        c.i1 += first;
+        c.i2 += first;
+        mDistanceConstraints.push_back(c);
+    }
+    for (uint32_t index : topology.constraintIndices)
+        mIndexPool.push_back(index + first);
+    mRestOffsetPool.insert(mRestOffsetPool.end(), topology.constraintRestOffsets.begin(), topology.constraintRestOffsets.end());
+
+    for (auto c : topology.volumeConstraints)
+    {
+        c.indices.begin += poolBegin;
+        mMaxVolumeSize = std::max(mMaxVolumeSize, c.indices.count);
+        mVolumeConstraints.push_back(c);
+    }
+    for (auto c : topology.angleConstraints)
+    {
+        c.i1 += first;
+        c.i2 += first;
+        c.i3 += first;
+        mAngleConstraints.push_back(c);
+    }
+    for (auto c : topology.shapeMatchingConstraints)
+    {
+        c.indices.begin += poolBegin;
+        c.restOffsetsBegin += restOffsetsBegin;
+        mShapeMatchingConstraints.push_back(c);
+    }
+    for (auto c : topology.pinConstraints)
+    {
+        c.index += first;
+        mPinConstraints.push_back(c);
+    }
+    for (uint32_t index : topology.collisionPoints)
+        mCollisionPoints.push_back(index + first);
+
+    size_t inputCount = mBodies.size() * mWorldCount;
+    accelerationX.assign(inputCount, 0.0f);
+    accelerationY.assign(inputCount, 0.0f);
+    angularAcceleration.assign(inputCount, 0.0f);
+    centerX.assign(inputCount, 0.0f);
+    centerY.assign(inputCount, 0.0f);
+    velocityX.assign(inputCount, 0.0f);
+    velocityY.assign(inputCount, 0.0f);
+
+    size_t stateSize = mBlockCount * mPointCount * L;
+    mX.assign(stateSize, 0.0f);
+    mY.assign(stateSize, 0.0f);
+    mPrevX.assign(stateSize, 0.0f);
+    mPrevY.assign(stateSize, 0.0f);
+    mVX.assign(stateSize, 0.0f);
+    mVY.assign(stateSize, 0.0f);
+    // padding lanes of the last block are simulated too, so they need a valid state
+    for (size_t w = 0; w < mBlockCount * L; ++w)
+        ResetWorld(w);
+
+    return uint32_t(mBodies.size() - 1);
+}
+
+void BatchWorld::AddDistanceJoint(uint32_t body1, uint32_t index1, uint32_t body2, uint32_t index2, float compliance)
+{
+    DistanceConstraint joint;
+    joint.i1 = mBodies[body1].firstPoint + index1;
+    joint.i2 = mBodies[body2].firstPoint + index2;
+    joint.restDistance = glm::length(mInitialPositions[joint.i1] - mInitialPositions[joint.i2]);
+    joint.compliance = compliance;
+    mJoints.push_back(joint);
+}
+
+void BatchWorld::ResetWorld(size_t world)
+{
+    size_t lane = Lane(world);
+    for (size_t i = 0; i < mPointCount; ++i, lane += L)
+    {
+        mX[lane] = mPrevX[lane] = mInitialPositions[i].x;
+        mY[lane] = mPrevY[lane] = mInitialPositions[i].y;
+        mVX[lane] = mVY[lane] = 0.0f;
+    }
+}
+
+glm::vec2 BatchWorld::GetPosition(size_t world, uint32_t body, uint32_t index) const
+{
+    size_t lane = Lane(world) + (mBodies[body].firstPoint + index) * L;
+    return glm::vec2(mX[lane], mY[lane]);
+}
+
+void BatchWorld::Step(float dt, int substeps, int iterations, JobSystem *jobSystem)
+{
+    size_t workerCount = jobSystem ? jobSystem->GetWorkerCount() : 1;
+    mLambdaCount = mDistanceConstraints.size() + mJoints.size() + mVolumeConstraints.size() +
+                   mAngleConstraints.size() + mShapeMatchingConstraints.size() + mPinConstraints.size();
+    mLambdas.resize(workerCount * mLambdaCount * L);
+    mScratch.resize(workerCount * 2 * mMaxVolumeSize * L);
+
+    // a whole step per block keeps the block's state in cache
+    float substepDt = dt / substeps;
+    auto stepBlocks = [&](size_t begin, size_t end)
+    {
+        size_t worker = jobSystem ? jobSystem->GetWorkerIndex() : 0;
+        float *lambdas = mLambdas.data() + worker * mLambdaCount * L;
+        float *scratch = mScratch.data() + worker * 2 * mMaxVolumeSize * L;
+        for (size_t block = begin; block < end; ++block)
+        {
+            for (int step = 0; step < substeps; ++step)
+                StepBlock(block, substepDt, iterations, lambdas, scratch);
+        }
+    };
+    if (jobSystem)
+        jobSystem->ParallelFor(mBlockCount, 1, stepBlocks);
+    else
+        stepBlocks(0, mBlockCount);
+}
+
+void BatchWorld::StepBlock(size_t block, float dt, int iterations, float *lambdas, float *scratch)
+{
+    size_t stride = mPointCount * L;
+    float *X = mX.data() + block * stride;
+    float *Y = mY.data() + block * stride;
+    float *prevX = mPrevX.data() + block * stride;
+    float *prevY = mPrevY.data() + block * stride;
+    float *VX = mVX.data() + block * stride;
+    float *VY = mVY.data() + block * stride;
+    const float *w = mInverseMasses.data();
+    float invDt2 = 1.0f / (dt * dt);
+
+    // inputs and integration
+    for (size_t b = 0; b < mBodies.size(); ++b)
+    {
+        const Body &body = mBodies[b];
+        float ax[L], ay[L], rc[L], rs[L], pivotX[L] = {}, pivotY[L] = {};
+        bool rotating = false;
+        for (size_t l = 0; l < L; ++l)
+        {
+            size_t world = block * L + l;
+            size_t input = b * mWorldCount + world;
+            bool live = world < mWorldCount;
+            ax[l] = gravity.x + (live ? accelerationX[input] : 0.0f);
+            ay[l] = gravity.y + (live ? accelerationY[input] : 0.0f);
+            float angle = live ? 0.5f * angularAcceleration[input] * dt * dt : 0.0f;
+            rc[l] = (std::cos(angle) - 1.0f) * invDt2;
+            rs[l] = std::sin(angle) * invDt2;
+            rotating = rotating || angle != 0.0f;
+        }
+        if (rotating)
+        {
+            for (uint32_t i = body.firstPoint; i < body.firstPoint + body.pointCount; ++i)
+                for (size_t l = 0; l < L; ++l)
+                {
+                    pivotX[l] += X[i * L + l];
+                    pivotY[l] += Y[i * L + l];
+                }
+            for (size_t l = 0; l < L; ++l)
+            {
+                pivotX[l] /= float(body.pointCount);
+                pivotY[l] /= float(body.pointCount);
+            }
+        }
+
+        for (uint32_t i = body.firstPoint; i < body.firstPoint + body.pointCount; ++i)
+        {
+            if (w[i] == 0.0f)
+                continue;
+            float *x = X + i * L, *y = Y + i * L;
+            float *px = prevX + i * L, *py = prevY + i * L;
+            float *vx = VX + i * L, *vy = VY + i * L;
+            for (size_t l = 0; l < L; ++l)
+            {
+                float rx = x[l] - pivotX[l];
+                float ry = y[l] - pivotY[l];
+                vx[l] += (ax[l] + rc[l] * rx - rs[l] * ry) * dt;
+                vy[l] += (ay[l] + rs[l] * rx + rc[l] * ry) * dt;
+                px[l] = x[l];
+                py[l] = y[l];
+                x[l] += vx[l] * dt;
+                y[l] += vy[l] * dt;
+            }
+        }
+    }
+
+    std::fill(lambdas, lambdas + mLambdaCount * L, 0.0f);
+    float *distanceLambdas = lambdas;
+    float *jointLambdas = distanceLambdas + mDistanceConstraints.size() * L;
+    float *volumeLambdas = jointLambdas + mJoints.size() * L;
+    float *angleLambdas = volumeLambdas + mVolumeConstraints.size() * L;
+    float *shapeMatchingLambdas = angleLambdas + mAngleConstraints.size() * L;
+    float *pinLambdas = shapeMatchingLambdas + mShapeMatchingConstraints.size() * L;
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        SolveDistanceLanes(X, Y, w, mDistanceConstraints.data(), mDistanceConstraints.size(), distanceLambdas, dt);
+        SolveVolumeLanes(X, Y, w, mVolumeConstraints.data(), mVolumeConstraints.size(), mIndexPool.data(), volumeLambdas, scratch, dt);
+        SolveAngleLanes(X, Y, w, mAngleConstraints.data(), mAngleConstraints.size(), angleLambdas, dt);
+        SolvePinLanes(X, Y, w, mPinConstraints.data(), mPinConstraints.size(), pinLambdas, dt);
+        SolveShapeMatchingLanes(X, Y, w, mShapeMatchingConstraints.data(), mShapeMatchingConstraints.size(), mIndexPool.data(), mRestOffsetPool.data(), shapeMatchingLambdas, dt);
+    }
+    for (int i = 0; i < iterations; ++i)
+        SolveDistanceLanes(X, Y, w, mJoints.data(), mJoints.size(), jointLambdas, dt);
+
+    // terrain contacts: push out along the heightfield normal, static friction against the displacement
+    if (mTerrain.heights.size() >= 2)
+    {
+        float maxU = float(mTerrain.heights.size() - 1) - 1e-3f;
+        float invSpacing = 1.0f / mTerrain.spacing;
+        float alphaTilde = contactCompliance * invDt2;
+
+        for (uint32_t i : mCollisionPoints)
+        {
+            if (w[i] == 0.0f)
+                continue;
+            float *x = X + i * L, *y = Y + i * L;
+            const float *px = prevX + i * L, *py = prevY + i * L;
+            for (int it = 0; it < iterations; ++it)
+            {
+                for (size_t l = 0; l < L; ++l)
+                {
+                    float u = std::min(std::max((x[l] - mTerrain.minX) * invSpacing, 0.0f), maxU);
+                    size_t cell = size_t(u);
+                    float h0 = mTerrain.heights[cell];
+                    float h1 = mTerrain.heights[cell + 1];
+                    float h = h0 + (u - float(cell)) * (h1 - h0);
+                    float slope = (h1 - h0) * invSpacing;
+                    float invLen = 1.0f / std::sqrt(1.0f + slope * slope);
+                    float nx = -slope * invLen;
+                    float ny = invLen;
+
+                    float depth = (h - y[l]) * ny;
+                    float dl = depth > 0.0f ? depth / (w[i] + alphaTilde) : 0.0f;
+                    x[l] += w[i] * dl * nx;
+                    y[l] += w[i] * dl * ny;
+
+                    float tangential = (x[l] - px[l]) * ny - (y[l] - py[l]) * nx;
+                    float maxFriction = frictionStatic * dl;
+                    float correction = std::min(std::max(-tangential, -maxFriction), maxFriction);
+                    x[l] += correction * ny;
+                    y[l] -= correction * nx;
+                }
+            }
+        }
+    }
+
+    float invDt = 1.0f / dt;
+    for (size_t i = 0; i < mPointCount; ++i)
+    {
+        if (w[i] == 0.0f)
+            continue;
+        for (size_t l = 0; l < L; ++l)
+        {
+            VX[i * L + l] = (X[i * L + l] - prevX[i * L + l]) * invDt;
+            VY[i * L + l] = (Y[i * L + l] - prevY[i * L + l]) * invDt;
+        }
+    }
+}
+
+void BatchWorld::ComputeObservations()
+{
+    for (size_t b = 0; b < mBodies.size(); ++b)
+    {
+        const Body &body = mBodies[b];
+        float invCount = body.pointCount > 0 ? 1.0f / float(body.pointCount) : 0.0f;
+        for (size_t world = 0; world < mWorldCount; ++world)
+        {
+            size_t lane = Lane(world) + body.firstPoint * L;
+            glm::vec2 center(0.0f), velocity(0.0f);
+            for (uint32_t i = 0; i < body.pointCount; ++i, lane += L)
+            {
+                center += glm::vec2(mX[lane], mY[lane]);
+                velocity += glm::vec2(mVX[lane], mVY[lane]);
+            }
+            size_t output = b * mWorldCount + world;
+            centerX[output] = center.x * invCount;
+            centerY[output] = center.y * invCount;
+            velocityX[output] = velocity.x * invCount;
+            velocityY[output] = velocity.y * invCount;
+        }
+    }
+}
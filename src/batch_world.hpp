@@ -0,0 +1,94 @@
+#pragma once
+#include "soft_body.hpp"
+#include "level.hpp"
+#include "glm/glm.hpp"
+#include <vector>
+
+class JobSystem;
+
+// worlds per block; one block is the unit the kernels sweep, so every per-point loop runs over lanes
+const size_t BATCH_LANES = 8;
+
+// Level sampled at a fixed spacing, clamped outside [minX, minX + spacing * (heights.size() - 1)]
+struct BatchTerrain
+{
+    float minX = 0.0f;
+    float spacing = 1.0f;
+    std::vector<float> heights;
+};
+
+BatchTerrain BuildBatchTerrain(const Level &level, float minX, float maxX, float spacing);
+
+// N independent copies of one small scene (e.g. a car on Level terrain) stepped in lockstep.
+// Particle state is stored as [block][point][lane] with the world as the inner lane, so every
+// constraint is solved for BATCH_LANES worlds at once by the same kernel.
+// Bodies collide with the terrain only, not with each other.
+class BatchWorld
+{
+public:
+    explicit BatchWorld(size_t worldCount);
+
+    // every world starts from the prototype's current state; resets all worlds, returns the body index
+    uint32_t AddBody(const SoftBody &prototype);
+    // point indices are the bodies' current ones (see RemapPointIndex)
+    void AddDistanceJoint(uint32_t body1, uint32_t index1, uint32_t body2, uint32_t index2, float compliance = 0.0f);
+    void SetTerrain(const BatchTerrain &terrain) { mTerrain = terrain; }
+
+    // blocks are independent, so a job system steps them in parallel
+    void Step(float dt, int substeps, int iterations, JobSystem *jobSystem = nullptr);
+    void ResetWorld(size_t world);
+    void ComputeObservations();
+
+    size_t GetWorldCount() const { return mWorldCount; }
+    size_t GetPointCount() const { return mPointCount; }
+    glm::vec2 GetPosition(size_t world, uint32_t body, uint32_t index) const;
+
+    glm::vec2 gravity = glm::vec2(0.0f, -9.8f);
+    float contactCompliance = 0.0001f;
+    float frictionStatic = 1.0f;
+
+    // per-world inputs, [body * worldCount + world]; linear acceleration and angular acceleration
+    // about the body's geometry center
+    std::vector<float> accelerationX, accelerationY, angularAcceleration;
+
+    // filled by ComputeObservations, [body * worldCount + world]
+    std::vector<float> centerX, centerY, velocityX, velocityY;
+
+private:
+    struct Body
+    {
+        uint32_t firstPoint;
+        uint32_t pointCount;
+    };
+
+    void StepBlock(size_t block, float dt, int iterations, float *lambdas, float *scratch);
+    size_t Lane(size_t world) const { return (world / BATCH_LANES) * mPointCount * BATCH_LANES + world % BATCH_LANES; }
+
+    size_t mWorldCount;
+    size_t mBlockCount;
+    size_t mPointCount = 0;
+    std::vector<Body> mBodies;
+    BatchTerrain mTerrain;
+
+    // shared topology, point indices global over all bodies
+    std::vector<glm::vec2> mInitialPositions;
+    std::vector<float> mInverseMasses;
+    std::vector<DistanceConstraint> mDistanceConstraints;
+    std::vector<DistanceConstraint> mJoints;
+    std::vector<VolumeConstraint> mVolumeConstraints;
+    std::vector<AngleConstraint> mAngleConstraints;
+    std::vector<ShapeMatchingConstraint> mShapeMatchingConstraints;
+    std::vector<PinConstraint> mPinConstraints;
+    std::vector<uint32_t> mIndexPool;
+    std::vector<glm::vec2> mRestOffsetPool;
+    std::vector<uint32_t> mCollisionPoints;
+    uint32_t mMaxVolumeSize = 0;
+
+    // [block][point][lane]
+    std::vector<float> mX, mY, mPrevX, mPrevY, mVX, mVY;
+
+    // per-worker scratch, reset every substep
+    size_t mLambdaCount = 0;
+    std::vector<float> mLambdas;
+    std::vector<float> mScratch;
+};
@@ -1,3 +1,4 @@
+#pragma once
 #include "glm/glm.hpp"
 #include "soft_body.hpp"
 #include "joint_system.hpp"
@@ -10,4 +11,30 @@ public:
     std::vector<std::shared_ptr<SoftBody>> wheels;
     std::vector<std::shared_ptr<DistanceJoint>> distanceJoints;
     std::vector<std::shared_ptr<MotorJoint>> motorJoints;
-};
\ No newline at end of file
+};
+
+// plain description of a car, shared by the JSON and binary loaders
+struct WheelDefinition
+{
+    glm::vec2 position = glm::vec2(0.0f);
+    float radius = 50.0f;
+    float diskMass = 10.0f;
+    float tireMass = 5.0f;
+    float tireRatio = 0.5f;
+    float diskHubCompliance = 0.0f;
+    float diskRimCompliance = 0.0f;
+    float tireBodyCompliance = 0.001f;
+    float tireTreadCompliance = 0.001f;
+    float tirePressureCompliance = 0.0f;
+    float tirePressure = 1.0f;
+    int32_t segments = 3;
+    float jointCompliance = 0.0f;
+    IndexRange bodyIndices; // original body point indices in CarDefinition::bodyIndices
+};
+
+struct CarDefinition
+{
+    std::shared_ptr<const SoftBodyTemplate> body;
+    std::vector<WheelDefinition> wheels;
+    std::vector<uint32_t> bodyIndices;
+};
@@ -4,136 +4,1220 @@
 #include "utils.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CONTACT_SOLVER_SSE2
+#endif
 
-void DetectSoftSoftCollisions(
+
+// 1 if the shape winds counter-clockwise, so the body is left of every edge; -1 otherwise
+static float ShapeOrientation(const std::vector<glm::vec2> &positions, const std::vector<uint32_t> &shape)
+{
+    float area = 0.0f;
+    for (size_t i = 0; i < shape.size(); ++i)
+        area += Cross2D(positions[shape[i]], positions[shape[(i + 1) % shape.size()]]);
+    return area >= 0.0f ? 1.0f : -1.0f;
+}
+
+static float MaxSpeed(const PointMasses &pointMasses)
+{
+    float maxSpeedSq = 0.0f;
+    for (const glm::vec2 &v : pointMasses.velocities)
+        maxSpeedSq = std::max(maxSpeedSq, glm::dot(v, v));
+    return std::sqrt(maxSpeedSq);
+}
+
+std::shared_ptr<const StaticEdgeGrid> BuildStaticEdgeGrid(const SoftBody &softBody)
+{
+    const auto &positions = softBody.pointMasses.positions;
+    const auto &shape = softBody.topology->collisionShape;
+    if (shape.size() < 2)
+        return nullptr;
+
+    auto grid = std::make_shared<StaticEdgeGrid>();
+    grid->min = glm::vec2(std::numeric_limits<float>::max());
+    grid->max = glm::vec2(-std::numeric_limits<float>::max());
+    for (auto index : shape)
+    {
+        grid->min = glm::min(grid->min, positions[index]);
+        grid->max = glm::max(grid->max, positions[index]);
+    }
+
+    grid->orientation = ShapeOrientation(positions, shape);
+
+    glm::vec2 extent = grid->max - grid->min;
+    grid->axis = extent.x >= extent.y ? 0 : 1;
+    size_t edgeCount = shape.size();
+    size_t cellCount = std::clamp<size_t>(edgeCount, 1, 4096);
+    grid->cellSize = std::max(extent[grid->axis] / cellCount, 1e-3f);
+
+    auto cellRange = [&](size_t edge, size_t &first, size_t &last)
+    {
+        float a = positions[shape[edge]][grid->axis];
+        float b = positions[shape[(edge + 1) % edgeCount]][grid->axis];
+        float lo = (std::min(a, b) - grid->min[grid->axis]) / grid->cellSize;
+        float hi = (std::max(a, b) - grid->min[grid->axis]) / grid->cellSize;
+        first = std::min<size_t>(static_cast<size_t>(std::max(lo, 0.0f)), cellCount - 1);
+        last = std::min<size_t>(static_cast<size_t>(std::max(hi, 0.0f)), cellCount - 1);
+    };
+
+    grid->cellStarts.assign(cellCount + 1, 0);
+    for (size_t e = 0; e < edgeCount; ++e)
+    {
+        size_t first, last;
+        cellRange(e, first, last);
+        for (size_t c = first; c <= last; ++c)
+            ++grid->cellStarts[c + 1];
+    }
+    for (size_t c = 0; c < cellCount; ++c)
+        grid->cellStarts[c + 1] += grid->cellStarts[c];
+
+    grid->cellEdges.resize(grid->cellStarts[cellCount]);
+    std::vector<uint32_t> fill(grid->cellStarts.begin(), grid->cellStarts.end() - 1);
+    for (size_t e = 0; e < edgeCount; ++e)
+    {
+        size_t first, last;
+        cellRange(e, first, last);
+        for (size_t c = first; c <= last; ++c)
+            grid->cellEdges[fill[c]++] = e;
+    }
+
+    return grid;
+}
+
+BodyBounds ComputeBodyBounds(const SoftBody &softBody, bool swept, float speculativeTime)
+{
+    BodyBounds bounds;
+    bounds.min = glm::vec2(std::numeric_limits<float>::max());
+    bounds.max = glm::vec2(-std::numeric_limits<float>::max());
+    for (const glm::vec2 &p : softBody.pointMasses.positions)
+    {
+        bounds.min = glm::min(bounds.min, p);
+        bounds.max = glm::max(bounds.max, p);
+    }
+    if (swept)
+    {
+        for (const glm::vec2 &p : softBody.pointMasses.prevPositions)
+        {
+            bounds.min = glm::min(bounds.min, p);
+            bounds.max = glm::max(bounds.max, p);
+        }
+    }
+    if (speculativeTime > 0.0f)
+    {
+        glm::vec2 margin(MaxSpeed(softBody.pointMasses) * speculativeTime);
+        bounds.min -= margin;
+        bounds.max += margin;
+    }
+    return bounds;
+}
+
+// samples of the field grid beyond the shape's rest bounds on every side, and at most per axis
+const int SIGNED_DISTANCE_FIELD_PADDING = 4;
+const int SIGNED_DISTANCE_FIELD_MAX_SAMPLES = 256;
+
+std::shared_ptr<const SignedDistanceField> BuildSignedDistanceField(const std::vector<glm::vec2> &restPositions, const std::vector<uint32_t> &shape, float cellSize)
+{
+    size_t n = shape.size();
+    if (n < 3 || !(cellSize > 0.0f))
+        return nullptr;
+
+    auto field = std::make_shared<SignedDistanceField>();
+    glm::vec2 center(0.0f);
+    for (uint32_t index : shape)
+        center += restPositions[index];
+    center /= float(n);
+
+    glm::vec2 lo(std::numeric_limits<float>::max());
+    glm::vec2 hi(-std::numeric_limits<float>::max());
+    for (uint32_t index : shape)
+    {
+        glm::vec2 q = restPositions[index] - center;
+        field->restOffsets.push_back(q);
+        lo = glm::min(lo, q);
+        hi = glm::max(hi, q);
+    }
+    const int pad = SIGNED_DISTANCE_FIELD_PADDING;
+    float maxExtent = std::max(hi.x - lo.x, hi.y - lo.y);
+    cellSize = std::max(cellSize, maxExtent / float(SIGNED_DISTANCE_FIELD_MAX_SAMPLES - 2 * pad - 1));
+    field->cellSize = cellSize;
+    field->origin = lo - glm::vec2(pad * cellSize);
+    field->width = int(std::ceil((hi.x - lo.x) / cellSize)) + 2 * pad + 1;
+    field->height = int(std::ceil((hi.y - lo.y) / cellSize)) + 2 * pad + 1;
+
+    const auto &offsets = field->restOffsets;
+    float orientation = ShapeOrientation(restPositions, shape);
+    size_t sampleCount = size_t(field->width) * field->height;
+    field->distances.resize(sampleCount);
+    field->gradients.resize(sampleCount);
+    field->nearestEdges.resize(sampleCount);
+    for (int y = 0; y < field->height; ++y)
+    {
+        for (int x = 0; x < field->width; ++x)
+        {
+            glm::vec2 sample = field->origin + glm::vec2(float(x), float(y)) * cellSize;
+            float minDist = std::numeric_limits<float>::max();
+            uint32_t nearestEdge = 0;
+            glm::vec2 nearestPoint(0.0f);
+            for (size_t e = 0; e < n; ++e)
+            {
+                const glm::vec2 &a = offsets[e];
+                glm::vec2 edge = offsets[(e + 1) % n] - a;
+                float lengthSq = glm::dot(edge, edge);
+                float t = lengthSq > 1e-12f ? glm::clamp(glm::dot(sample - a, edge) / lengthSq, 0.0f, 1.0f) : 0.0f;
+                glm::vec2 closest = a + edge * t;
+                float dist = glm::length(sample - closest);
+                if (dist < minDist)
+                {
+                    minDist = dist;
+                    nearestEdge = uint32_t(e);
+                    nearestPoint = closest;
+                }
+            }
+
+            float sign = PointInPolygon(sample, offsets) ? -1.0f : 1.0f;
+            glm::vec2 gradient;
+            if (minDist > 1e-6f)
+                gradient = sign * (sample - nearestPoint) / minDist;
+            else
+                gradient = glm::normalize(orientation * Perp2D(offsets[(nearestEdge + 1) % n] - offsets[nearestEdge]));
+
+            size_t k = size_t(y) * field->width + x;
+            field->distances[k] = sign * minDist;
+            field->gradients[k] = gradient;
+            field->nearestEdges[k] = nearestEdge;
+        }
+    }
+    return field;
+}
+
+SignedDistanceSample SampleSignedDistanceField(const SignedDistanceField &field, const glm::vec2 &localPoint)
+{
+    glm::vec2 g = (localPoint - field.origin) / field.cellSize;
+    glm::vec2 clamped = glm::clamp(g, glm::vec2(0.0f), glm::vec2(float(field.width - 1), float(field.height - 1)));
+    int x0 = std::min(int(clamped.x), field.width - 2);
+    int y0 = std::min(int(clamped.y), field.height - 2);
+    float fx = clamped.x - float(x0);
+    float fy = clamped.y - float(y0);
+
+    size_t k00 = size_t(y0) * field.width + x0;
+    size_t k10 = k00 + 1;
+    size_t k01 = k00 + field.width;
+    size_t k11 = k01 + 1;
+    auto bilinear = [&](const auto &values)
+    {
+        return (values[k00] * (1.0f - fx) + values[k10] * fx) * (1.0f - fy) + (values[k01] * (1.0f - fx) + values[k11] * fx) * fy;
+    };
+
+    SignedDistanceSample sample;
+    sample.inGrid = clamped == g;
+    // outside the grid the border sample plus the way to it bounds the distance from above
+    sample.distance = bilinear(field.distances) + glm::length(g - clamped) * field.cellSize;
+    sample.gradient = bilinear(field.gradients);
+    float length = glm::length(sample.gradient);
+    if (length > 1e-6f)
+        sample.gradient /= length;
+    int nx = std::min(int(clamped.x + 0.5f), field.width - 1);
+    int ny = std::min(int(clamped.y + 0.5f), field.height - 1);
+    sample.nearestEdge = field.nearestEdges[size_t(ny) * field.width + nx];
+    return sample;
+}
+
+// where a body's field sits: centroid and best-fit rotation (cos, sin) of its shape points, the
+// rotation part of Apq as in SolveShapeMatchingConstraints
+struct FieldFrame
+{
+    glm::vec2 center;
+    glm::vec2 rotation;
+};
+
+static FieldFrame ComputeFieldFrame(const SignedDistanceField &field, const std::vector<glm::vec2> &positions, const std::vector<uint32_t> &shape)
+{
+    FieldFrame frame;
+    frame.center = glm::vec2(0.0f);
+    for (uint32_t index : shape)
+        frame.center += positions[index];
+    frame.center /= float(shape.size());
+
+    float cosR = 0.0f, sinR = 0.0f;
+    for (size_t i = 0; i < shape.size(); ++i)
+    {
+        glm::vec2 p = positions[shape[i]] - frame.center;
+        const glm::vec2 &q = field.restOffsets[i];
+        cosR += p.x * q.x + p.y * q.y;
+        sinR += p.y * q.x - p.x * q.y;
+    }
+    float len = std::sqrt(cosR * cosR + sinR * sinR);
+    frame.rotation = len < 1e-6f ? glm::vec2(1.0f, 0.0f) : glm::vec2(cosR, sinR) / len;
+    return frame;
+}
+
+static glm::vec2 ToFieldFrame(const FieldFrame &frame, const glm::vec2 &point)
+{
+    glm::vec2 d = point - frame.center;
+    return glm::vec2(frame.rotation.x * d.x + frame.rotation.y * d.y, frame.rotation.x * d.y - frame.rotation.y * d.x);
+}
+
+static float PointEdgeDistance(const glm::vec2 &point, const glm::vec2 &e1, const glm::vec2 &e2)
+{
+    glm::vec2 edge = e2 - e1;
+    float len = glm::length(edge);
+    if (len < 1e-6f)
+        return std::numeric_limits<float>::max();
+
+    glm::vec2 dir = edge / len;
+    float proj = glm::clamp(glm::dot(point - e1, dir), 0.0f, len);
+    return glm::length(point - (e1 + dir * proj));
+}
+
+static uint32_t NearestEdge(const glm::vec2 &point, const std::vector<glm::vec2> &positions, const std::vector<uint32_t> &shape, float &minDist)
+{
+    minDist = std::numeric_limits<float>::max();
+    uint32_t nearestEdge = 0;
+    size_t n = shape.size();
+    for (size_t i = 0; i < n; ++i)
+    {
+        float dist = PointEdgeDistance(point, positions[shape[i]], positions[shape[(i + 1) % n]]);
+        if (dist < minDist)
+        {
+            minDist = dist;
+            nearestEdge = uint32_t(i);
+        }
+    }
+    return nearestEdge;
+}
+
+// from a cached edge towards the closer neighbour while the distance keeps dropping
+static uint32_t WalkNearestEdge(const glm::vec2 &point, const std::vector<glm::vec2> &positions, const std::vector<uint32_t> &shape, uint32_t edge, float &minDist)
+{
+    size_t n = shape.size();
+    auto edgeDistance = [&](size_t e)
+    {
+        return PointEdgeDistance(point, positions[shape[e]], positions[shape[(e + 1) % n]]);
+    };
+
+    minDist = edgeDistance(edge);
+    float prevDist = edgeDistance((edge + n - 1) % n);
+    float nextDist = edgeDistance((edge + 1) % n);
+    size_t direction;
+    if (nextDist < minDist && nextDist <= prevDist)
+        direction = 1;
+    else if (prevDist < minDist)
+        direction = n - 1;
+    else
+        return edge;
+
+    for (size_t step = 1; step < n; ++step)
+    {
+        uint32_t candidate = uint32_t((edge + direction) % n);
+        float dist = edgeDistance(candidate);
+        if (dist >= minDist)
+            break;
+        edge = candidate;
+        minDist = dist;
+    }
+    return edge;
+}
+
+static bool CacheEntryLess(const NearestEdgeCache::Entry &a, const NearestEdgeCache::Entry &b)
+{
+    std::less<const SoftBody *> less;
+    if (a.bodyA != b.bodyA)
+        return less(a.bodyA, b.bodyA);
+    if (a.bodyB != b.bodyB)
+        return less(a.bodyB, b.bodyB);
+    return a.pointIndex < b.pointIndex;
+}
+
+// entries of one body pair, [first, last)
+static void FindCachedPair(const NearestEdgeCache &cache, const SoftBody &bodyA, const SoftBody &bodyB, const NearestEdgeCache::Entry *&first, const NearestEdgeCache::Entry *&last)
+{
+    NearestEdgeCache::Entry lo = {&bodyA, &bodyB, 0, 0};
+    NearestEdgeCache::Entry hi = {&bodyA, &bodyB, std::numeric_limits<uint32_t>::max(), 0};
+    const NearestEdgeCache::Entry *begin = cache.entries.data();
+    const NearestEdgeCache::Entry *end = begin + cache.entries.size();
+    first = std::lower_bound(begin, end, lo, CacheEntryLess);
+    last = std::upper_bound(first, end, hi, CacheEntryLess);
+}
+
+void BuildNearestEdgeCache(const std::vector<SoftSoftCollisionConstraint> &constraints, NearestEdgeCache &cache)
+{
+    cache.entries.resize(constraints.size());
+    for (size_t i = 0; i < constraints.size(); ++i)
+    {
+        const SoftSoftCollisionConstraint &c = constraints[i];
+        cache.entries[i] = {c.softBodyA, c.softBodyB, c.pointIndex, c.edgeIndex};
+    }
+    std::sort(cache.entries.begin(), cache.entries.end(), CacheEntryLess);
+}
+
+bool PointInStaticGrid(const glm::vec2 &point, const std::vector<glm::vec2> &positions, const std::vector<uint32_t> &shape, const StaticEdgeGrid &grid)
+{
+    if (point.x < grid.min.x || point.y < grid.min.y || point.x > grid.max.x || point.y > grid.max.y)
+        return false;
+
+    // winding number with the ray running across the cells; only edges spanning point[axis] count
+    int u = grid.axis;
+    int v = 1 - grid.axis;
+    size_t cellCount = grid.cellStarts.size() - 1;
+    size_t cell = std::min<size_t>(static_cast<size_t>((point[u] - grid.min[u]) / grid.cellSize), cellCount - 1);
+
+    int windingNumber = 0;
+    size_t n = shape.size();
+    for (uint32_t k = grid.cellStarts[cell]; k < grid.cellStarts[cell + 1]; ++k)
+    {
+        uint32_t e = grid.cellEdges[k];
+        glm::vec2 v1(positions[shape[e]][v], positions[shape[e]][u]);
+        glm::vec2 v2(positions[shape[(e + 1) % n]][v], positions[shape[(e + 1) % n]][u]);
+        glm::vec2 p(point[v], point[u]);
+        if (v1.y <= p.y)
+        {
+            if (v2.y > p.y && Cross2D(v2 - v1, p - v1) > 0)
+                ++windingNumber;
+        }
+        else
+        {
+            if (v2.y <= p.y && Cross2D(v2 - v1, p - v1) < 0)
+                --windingNumber;
+        }
+    }
+    return windingNumber != 0;
+}
+
+// walks cells outward from the point until they are farther away than the best edge found
+uint32_t NearestEdgeInStaticGrid(const glm::vec2 &point, const std::vector<glm::vec2> &positions, const std::vector<uint32_t> &shape, const StaticEdgeGrid &grid)
+{
+    int u = grid.axis;
+    long cellCount = grid.cellStarts.size() - 1;
+    long cell = std::clamp<long>(static_cast<long>((point[u] - grid.min[u]) / grid.cellSize), 0, cellCount - 1);
+    size_t n = shape.size();
+
+    float minDist = std::numeric_limits<float>::max();
+    uint32_t nearestEdge = 0;
+
+    auto scanCell = [&](long c)
+    {
+        for (uint32_t k = grid.cellStarts[c]; k < grid.cellStarts[c + 1]; ++k)
+        {
+            uint32_t e = grid.cellEdges[k];
+            float dist = PointEdgeDistance(point, positions[shape[e]], positions[shape[(e + 1) % n]]);
+            if (dist < minDist || (dist == minDist && e < nearestEdge))
+            {
+                minDist = dist;
+                nearestEdge = e;
+            }
+        }
+    };
+
+    scanCell(cell);
+    for (long k = 1; k < cellCount; ++k)
+    {
+        bool searched = false;
+        long lo = cell - k;
+        long hi = cell + k;
+        if (lo >= 0 && point[u] - (grid.min[u] + (lo + 1) * grid.cellSize) < minDist)
+        {
+            scanCell(lo);
+            searched = true;
+        }
+        if (hi < cellCount && grid.min[u] + hi * grid.cellSize - point[u] < minDist)
+        {
+            scanCell(hi);
+            searched = true;
+        }
+        if (!searched)
+            break;
+    }
+
+    return nearestEdge;
+}
+
+// Earliest t in [earliest, 1] at which the point p0 -> p1 crosses the edge (a0, b0) -> (a1, b1)
+// into the body, all of them moving linearly over the substep; toi is clamped to 0. The body is on
+// the side where Cross2D(b - a, p - a) has the sign of orientation.
+static bool SweepPointEdge(
+    const glm::vec2 &p0, const glm::vec2 &p1,
+    const glm::vec2 &a0, const glm::vec2 &a1,
+    const glm::vec2 &b0, const glm::vec2 &b1,
+    float orientation,
+    float earliest,
+    float &toi)
+{
+    glm::vec2 pStart = p0 + (p1 - p0) * earliest;
+    glm::vec2 aStart = a0 + (a1 - a0) * earliest;
+    glm::vec2 bStart = b0 + (b1 - b0) * earliest;
+    glm::vec2 lo = glm::min(glm::min(aStart, a1), glm::min(bStart, b1));
+    glm::vec2 hi = glm::max(glm::max(aStart, a1), glm::max(bStart, b1));
+    if (std::max(pStart.x, p1.x) < lo.x || std::min(pStart.x, p1.x) > hi.x || std::max(pStart.y, p1.y) < lo.y || std::min(pStart.y, p1.y) > hi.y)
+        return false;
+
+    // the point is on the edge's line where f(t) = Cross2D(d(t), q(t)) = qa t^2 + qb t + qc is zero
+    glm::vec2 d0 = b0 - a0;
+    glm::vec2 dd = (b1 - a1) - d0;
+    glm::vec2 q0 = p0 - a0;
+    glm::vec2 dq = (p1 - a1) - q0;
+    float qa = Cross2D(dd, dq);
+    float qb = Cross2D(d0, dq) + Cross2D(dd, q0);
+    float qc = Cross2D(d0, q0);
+
+    float roots[2];
+    int rootCount = 0;
+    if (qa == 0.0f)
+    {
+        if (qb != 0.0f)
+            roots[rootCount++] = -qc / qb;
+    }
+    else
+    {
+        float discriminant = qb * qb - 4.0f * qa * qc;
+        if (discriminant < 0.0f)
+            return false;
+        float q = -0.5f * (qb + std::copysign(std::sqrt(discriminant), qb));
+        if (q == 0.0f)
+            roots[rootCount++] = 0.0f;
+        else
+        {
+            roots[rootCount++] = std::min(q / qa, qc / q);
+            roots[rootCount++] = std::max(q / qa, qc / q);
+        }
+    }
+
+    for (int r = 0; r < rootCount; ++r)
+    {
+        float t = roots[r];
+        if (t < earliest || t > 1.0f)
+            continue;
+        // crossing inwards, not leaving
+        if ((qb + 2.0f * qa * t) * orientation <= 0.0f)
+            continue;
+
+        glm::vec2 d = d0 + dd * t;
+        float lengthSq = glm::dot(d, d);
+        if (lengthSq < 1e-12f)
+            continue;
+        float s = glm::dot(q0 + dq * t, d) / lengthSq;
+        if (s < 0.0f || s > 1.0f)
+            continue;
+
+        toi = std::max(t, 0.0f);
+        return true;
+    }
+    return false;
+}
+
+// first edge the point sweeps into; static edges do not move
+static bool SweepStaticGrid(const glm::vec2 &p0, const glm::vec2 &p1, const std::vector<glm::vec2> &positions, const std::vector<uint32_t> &shape, const StaticEdgeGrid &grid, float earliest, uint32_t &hitEdge)
+{
+    glm::vec2 start = p0 + (p1 - p0) * earliest;
+    glm::vec2 lo = glm::min(start, p1);
+    glm::vec2 hi = glm::max(start, p1);
+    if (hi.x < grid.min.x || hi.y < grid.min.y || lo.x > grid.max.x || lo.y > grid.max.y)
+        return false;
+
+    int u = grid.axis;
+    long cellCount = grid.cellStarts.size() - 1;
+    long first = std::clamp<long>(static_cast<long>((lo[u] - grid.min[u]) / grid.cellSize), 0, cellCount - 1);
+    long last = std::clamp<long>(static_cast<long>((hi[u] - grid.min[u]) / grid.cellSize), 0, cellCount - 1);
+    size_t n = shape.size();
+
+    float firstToi = 2.0f;
+    for (long c = first; c <= last; ++c)
+    {
+        for (uint32_t k = grid.cellStarts[c]; k < grid.cellStarts[c + 1]; ++k)
+        {
+            uint32_t e = grid.cellEdges[k];
+            const glm::vec2 &a = positions[shape[e]];
+            const glm::vec2 &b = positions[shape[(e + 1) % n]];
+            float toi;
+            if (!SweepPointEdge(p0, p1, a, a, b, b, grid.orientation, earliest, toi))
+                continue;
+            if (toi < firstToi || (toi == firstToi && e < hitEdge))
+            {
+                firstToi = toi;
+                hitEdge = e;
+            }
+        }
+    }
+    return firstToi <= 1.0f;
+}
+
+static bool SweepEdges(const glm::vec2 &p0, const glm::vec2 &p1, const PointMasses &pointMassesB, const std::vector<uint32_t> &shape, float orientation, float earliest, uint32_t &hitEdge)
+{
+    const auto &positions = pointMassesB.positions;
+    const auto &prevPositions = pointMassesB.prevPositions;
+    size_t n = shape.size();
+
+    float firstToi = 2.0f;
+    for (size_t e = 0; e < n; ++e)
+    {
+        uint32_t i0 = shape[e];
+        uint32_t i1 = shape[(e + 1) % n];
+        float toi;
+        if (SweepPointEdge(p0, p1, prevPositions[i0], positions[i0], prevPositions[i1], positions[i1], orientation, earliest, toi) && toi < firstToi)
+        {
+            firstToi = toi;
+            hitEdge = uint32_t(e);
+        }
+    }
+    return firstToi <= 1.0f;
+}
+
+static void PushSoftSoftCollision(
     SoftBody &bodyA,
     SoftBody &bodyB,
+    uint32_t indexA,
+    uint32_t nearestEdge,
     float compliance,
     float frictionStatic,
     float frictionKinetic,
+    float normalSign,
     std::vector<SoftSoftCollisionConstraint> &outConstraints)
+{
+    const auto &shapeB = bodyB.topology->collisionShape;
+
+    SoftSoftCollisionConstraint constraint;
+    constraint.softBodyA = &bodyA;
+    constraint.softBodyB = &bodyB;
+    constraint.pointIndex = indexA;
+    constraint.edgePointIndex0 = shapeB[nearestEdge];
+    constraint.edgePointIndex1 = shapeB[(nearestEdge + 1) % shapeB.size()];
+    constraint.edgeIndex = nearestEdge;
+    constraint.compliance = compliance;
+    constraint.frictionStatic = frictionStatic;
+    constraint.frictionKinetic = frictionKinetic;
+    constraint.normalSign = normalSign;
+    outConstraints.push_back(constraint);
+}
+
+void DetectSoftSoftCollisions(
+    SoftBody &bodyA,
+    SoftBody &bodyB,
+    float compliance,
+    float frictionStatic,
+    float frictionKinetic,
+    std::vector<SoftSoftCollisionConstraint> &outConstraints,
+    bool continuous,
+    float speculativeTime,
+    const NearestEdgeCache *edgeCache)
 {
     const auto &positionsA = bodyA.pointMasses.positions;
+    const auto &prevPositionsA = bodyA.pointMasses.prevPositions;
+    const auto &velocitiesA = bodyA.pointMasses.velocities;
     const auto &positionsB = bodyB.pointMasses.positions;
-    const auto &shapeB = bodyB.collisionShape;
+    const auto &shapeB = bodyB.topology->collisionShape;
 
     if (shapeB.size() < 2)
         return;
 
+    // speculative contacts are one-sided, so a point that separates later in the tick is let go
+    bool speculative = speculativeTime > 0.0f;
+    if (speculative)
+        continuous = false;
+
+    if (bodyB.type == BodyType::Static && !bodyB.staticEdgeGrid)
+        bodyB.staticEdgeGrid = BuildStaticEdgeGrid(bodyB);
+
+    // the last contact edge of a point is a good start, nearest edges rarely change between substeps
+    const NearestEdgeCache::Entry *cachedFirst = nullptr;
+    const NearestEdgeCache::Entry *cachedLast = nullptr;
+    if (edgeCache)
+        FindCachedPair(*edgeCache, bodyA, bodyB, cachedFirst, cachedLast);
+    auto findNearestEdge = [&](uint32_t indexA, float &dist)
+    {
+        const glm::vec2 &pointA = positionsA[indexA];
+        if (cachedFirst != cachedLast)
+        {
+            NearestEdgeCache::Entry key = {&bodyA, &bodyB, indexA, 0};
+            const NearestEdgeCache::Entry *cached = std::lower_bound(cachedFirst, cachedLast, key, CacheEntryLess);
+            if (cached != cachedLast && cached->pointIndex == indexA && cached->edgeIndex < shapeB.size())
+                return WalkNearestEdge(pointA, positionsB, shapeB, cached->edgeIndex, dist);
+        }
+        uint32_t edge;
+        if (bodyB.type != BodyType::Static)
+            return NearestEdge(pointA, positionsB, shapeB, dist);
+        edge = NearestEdgeInStaticGrid(pointA, positionsB, shapeB, *bodyB.staticEdgeGrid);
+        dist = PointEdgeDistance(pointA, positionsB[shapeB[edge]], positionsB[shapeB[(edge + 1) % shapeB.size()]]);
+        return edge;
+    };
+
+    if (bodyB.type == BodyType::Static)
+    {
+        const StaticEdgeGrid &grid = *bodyB.staticEdgeGrid;
+        float normalSign = speculative ? grid.orientation : 0.0f;
+
+        for (uint32_t indexA : bodyA.topology->collisionPoints)
+        {
+            const glm::vec2 &pointA = positionsA[indexA];
+            bool inside = PointInStaticGrid(pointA, positionsB, shapeB, grid);
+            // a swept hit is the edge the point came in through. A point that ends outside may have
+            // gone through a thin part; it is also caught up to one substep after crossing, since a
+            // soft contact can leave it just past the edge line with its incoming velocity.
+            uint32_t hitEdge = 0;
+            if (continuous && SweepStaticGrid(prevPositionsA[indexA], pointA, positionsB, shapeB, grid, inside ? 0.0f : -1.0f, hitEdge))
+            {
+                PushSoftSoftCollision(bodyA, bodyB, indexA, hitEdge, compliance, frictionStatic, frictionKinetic, normalSign, outConstraints);
+                continue;
+            }
+            if (!inside && !speculative)
+                continue;
+
+            float margin = inside ? 0.0f : glm::length(velocitiesA[indexA]) * speculativeTime;
+            if (pointA.x < grid.min.x - margin || pointA.y < grid.min.y - margin || pointA.x > grid.max.x + margin || pointA.y > grid.max.y + margin)
+                continue;
+            float dist;
+            uint32_t nearestEdge = findNearestEdge(indexA, dist);
+            if (!inside && dist > margin)
+                continue;
+            PushSoftSoftCollision(bodyA, bodyB, indexA, nearestEdge, compliance, frictionStatic, frictionKinetic, normalSign, outConstraints);
+        }
+        return;
+    }
+
+    float orientationB = continuous || speculative ? ShapeOrientation(positionsB, shapeB) : 1.0f;
+    float normalSign = speculative ? orientationB : 0.0f;
+    BodyBounds sweptB;
+    if (continuous)
+        sweptB = ComputeBodyBounds(bodyB, true);
+    BodyBounds boundsB = ComputeBodyBounds(bodyB);
+    float speedB = speculative ? MaxSpeed(bodyB.pointMasses) : 0.0f;
+
+    // a signed distance field replaces the polygon test and the edge scan with one lookup; the nearest
+    // edge is looked up where the point projects onto the rest surface, then walked on the current shape
+    const SignedDistanceField *field = bodyB.topology->signedDistanceField.get();
+    if (field && field->restOffsets.size() != shapeB.size())
+        field = nullptr;
+    FieldFrame frame;
+    if (field)
+        frame = ComputeFieldFrame(*field, positionsB, shapeB);
+    auto fieldEdge = [&](uint32_t indexA, const glm::vec2 &local, const SignedDistanceSample &sample, float &dist)
+    {
+        uint32_t edge = SampleSignedDistanceField(*field, local - sample.gradient * sample.distance).nearestEdge;
+        return WalkNearestEdge(positionsA[indexA], positionsB, shapeB, edge, dist);
+    };
+
     std::vector<uint32_t> insideB;
-    for (uint32_t index : bodyA.collisionPoints)
+    for (uint32_t index : bodyA.topology->collisionPoints)
     {
-        if (PointInPolygon(positionsA[index], positionsB))
+        const glm::vec2 &p = positionsA[index];
+        bool inBoundsB = p.x >= boundsB.min.x && p.y >= boundsB.min.y && p.x <= boundsB.max.x && p.y <= boundsB.max.y;
+        glm::vec2 local;
+        SignedDistanceSample sample = {};
+        if (field && (inBoundsB || speculative))
+        {
+            local = ToFieldFrame(frame, p);
+            sample = SampleSignedDistanceField(*field, local);
+        }
+        bool inside = inBoundsB && (field ? sample.distance < 0.0f : PointInPolygon(p, positionsB));
+        if (continuous)
+        {
+            float earliest = inside ? 0.0f : -1.0f;
+            glm::vec2 start = prevPositionsA[index] + (positionsA[index] - prevPositionsA[index]) * earliest;
+            BodyBounds sweptA = {glm::min(start, positionsA[index]), glm::max(start, positionsA[index])};
+            uint32_t hitEdge = 0;
+            if (BoundsOverlap(sweptA, sweptB) && SweepEdges(prevPositionsA[index], positionsA[index], bodyB.pointMasses, shapeB, orientationB, earliest, hitEdge))
+            {
+                PushSoftSoftCollision(bodyA, bodyB, index, hitEdge, compliance, frictionStatic, frictionKinetic, normalSign, outConstraints);
+                continue;
+            }
+        }
+        if (speculative && !inside)
+        {
+            // both sides may close the gap within the tick
+            const glm::vec2 &pointA = positionsA[index];
+            float margin = (glm::length(velocitiesA[index]) + speedB) * speculativeTime;
+            BodyBounds marginA = {pointA - glm::vec2(margin), pointA + glm::vec2(margin)};
+            if (!BoundsOverlap(marginA, boundsB))
+                continue;
+            if (field && sample.inGrid && sample.distance > margin)
+                continue;
+            float dist;
+            uint32_t nearestEdge = field && sample.inGrid ? fieldEdge(index, local, sample, dist) : findNearestEdge(index, dist);
+            if (dist <= margin)
+                PushSoftSoftCollision(bodyA, bodyB, index, nearestEdge, compliance, frictionStatic, frictionKinetic, normalSign, outConstraints);
+            continue;
+        }
+        if (inside && field)
+        {
+            float dist;
+            PushSoftSoftCollision(bodyA, bodyB, index, fieldEdge(index, local, sample, dist), compliance, frictionStatic, frictionKinetic, normalSign, outConstraints);
+        }
+        else if (inside)
             insideB.push_back(index);
     }
 
     for (uint32_t indexA : insideB)
     {
-        const glm::vec2 &pointA = positionsA[indexA];
-        float minDist = std::numeric_limits<float>::max();
-        uint32_t nearestEdge = 0;
+        float dist;
+        uint32_t nearestEdge = findNearestEdge(indexA, dist);
+        PushSoftSoftCollision(bodyA, bodyB, indexA, nearestEdge, compliance, frictionStatic, frictionKinetic, normalSign, outConstraints);
+    }
+}
 
-        int shapeSize = shapeB.size();
-        for (int i = 0; i < shapeSize; ++i)
-        {
-            const glm::vec2 &e1 = positionsB[shapeB[i]];
-            const glm::vec2 &e2 = positionsB[shapeB[(i + 1) % shapeSize]];
+// outline points this close (in shape steps) to an edge's ends bend with it and are never tested
+const size_t SELF_COLLISION_RING_GAP = 2;
 
-            glm::vec2 edge = e2 - e1;
-            float len = glm::length(edge);
-            if (len < 1e-6f)
-                continue;
+void DetectSelfCollisions(
+    SoftBody &body,
+    float compliance,
+    float frictionStatic,
+    float frictionKinetic,
+    std::vector<SoftSoftCollisionConstraint> &outConstraints,
+    float speculativeTime)
+{
+    const auto &positions = body.pointMasses.positions;
+    const auto &prevPositions = body.pointMasses.prevPositions;
+    const auto &shape = body.topology->collisionShape;
+    const auto &points = body.topology->collisionPoints;
+    size_t n = shape.size();
+    if (n < 2 * SELF_COLLISION_RING_GAP + 2 || points.empty())
+        return;
+
+    float maxEdgeLength = 0.0f;
+    float totalEdgeLength = 0.0f;
+    for (size_t e = 0; e < n; ++e)
+    {
+        float length = glm::length(positions[shape[(e + 1) % n]] - positions[shape[e]]);
+        maxEdgeLength = std::max(maxEdgeLength, length);
+        totalEdgeLength += length;
+    }
+    // the outline is kept half an edge apart, so the side of an edge a point is on stays clear
+    // while soft contacts leave some penetration
+    float thickness = 0.5f * totalEdgeLength / n;
+    float maxDisplacement = MaxSpeed(body.pointMasses) * speculativeTime;
+    for (uint32_t index : points)
+        maxDisplacement = std::max(maxDisplacement, glm::length(positions[index] - prevPositions[index]));
+    // point and edge may close the gap from both sides
+    float margin = thickness + 2.0f * maxDisplacement;
+    float cellSize = std::max(maxEdgeLength, margin);
+    if (cellSize <= 0.0f)
+        return;
+
+    // uniform spatial hash of the collision points, counting sort into a power of two buckets
+    size_t tableSize = 1;
+    while (tableSize < 2 * points.size())
+        tableSize <<= 1;
+    auto cellOf = [&](float x)
+    {
+        return int(std::floor(x / cellSize));
+    };
+    auto hashCell = [&](int x, int y)
+    {
+        return size_t((uint32_t(x) * 92837111u) ^ (uint32_t(y) * 689287499u)) & (tableSize - 1);
+    };
+    std::vector<uint32_t> bucketStarts(tableSize + 1, 0);
+    for (uint32_t index : points)
+        bucketStarts[hashCell(cellOf(positions[index].x), cellOf(positions[index].y)) + 1]++;
+    for (size_t b = 0; b < tableSize; ++b)
+        bucketStarts[b + 1] += bucketStarts[b];
+    std::vector<uint32_t> bucketPoints(points.size());
+    std::vector<uint32_t> fill(bucketStarts.begin(), bucketStarts.end() - 1);
+    for (uint32_t index : points)
+        bucketPoints[fill[hashCell(cellOf(positions[index].x), cellOf(positions[index].y))]++] = index;
 
-            glm::vec2 dir = edge / len;
-            glm::vec2 toPoint = pointA - e1;
-            float proj = glm::clamp(glm::dot(toPoint, dir), 0.0f, len);
-            glm::vec2 closest = e1 + dir * proj;
-            float dist = glm::length(pointA - closest);
+    // position of every outline point in collisionShape, for the adjacency test
+    const uint32_t NOT_IN_SHAPE = 0xffffffffu;
+    std::vector<uint32_t> shapeSlot(positions.size(), NOT_IN_SHAPE);
+    for (size_t e = 0; e < n; ++e)
+        shapeSlot[shape[e]] = uint32_t(e);
 
-            if (dist < minDist)
+    // the nearest candidate edge per point, so a point gets at most one contact with its own body
+    std::vector<float> bestDistance(positions.size(), std::numeric_limits<float>::max());
+    std::vector<uint32_t> bestEdge(positions.size(), NOT_IN_SHAPE);
+    std::vector<float> bestSide(positions.size(), 0.0f);
+    for (size_t e = 0; e < n; ++e)
+    {
+        uint32_t i0 = shape[e];
+        uint32_t i1 = shape[(e + 1) % n];
+        const glm::vec2 &a = positions[i0];
+        const glm::vec2 &b = positions[i1];
+        glm::vec2 edge = b - a;
+        float edgeLengthSq = glm::dot(edge, edge);
+        if (edgeLengthSq < 1e-12f)
+            continue;
+        glm::vec2 normal = Perp2D(edge) / std::sqrt(edgeLengthSq);
+        glm::vec2 prevNormal = Perp2D(prevPositions[i1] - prevPositions[i0]);
+
+        glm::vec2 lo = glm::min(a, b) - glm::vec2(margin);
+        glm::vec2 hi = glm::max(a, b) + glm::vec2(margin);
+        for (int x = cellOf(lo.x); x <= cellOf(hi.x); ++x)
+        {
+            for (int y = cellOf(lo.y); y <= cellOf(hi.y); ++y)
             {
-                minDist = dist;
-                nearestEdge = i;
+                size_t bucket = hashCell(x, y);
+                for (uint32_t k = bucketStarts[bucket]; k < bucketStarts[bucket + 1]; ++k)
+                {
+                    uint32_t index = bucketPoints[k];
+                    const glm::vec2 &p = positions[index];
+                    if (index == i0 || index == i1 || p.x < lo.x || p.y < lo.y || p.x > hi.x || p.y > hi.y)
+                        continue;
+                    uint32_t slot = shapeSlot[index];
+                    if (slot != NOT_IN_SHAPE)
+                    {
+                        size_t gap0 = (slot + n - e) % n;
+                        size_t gap1 = (e + 1 + n - slot) % n;
+                        if (std::min(gap0, n - gap0) <= SELF_COLLISION_RING_GAP || std::min(gap1, n - gap1) <= SELF_COLLISION_RING_GAP)
+                            continue;
+                    }
+
+                    float t = glm::dot(p - a, edge) / edgeLengthSq;
+                    if (t < 0.0f || t > 1.0f)
+                        continue;
+                    // the point stays on the side of the edge it started the substep on
+                    float side = glm::dot(prevPositions[index] - prevPositions[i0], prevNormal) >= 0.0f ? 1.0f : -1.0f;
+                    float distance = side * glm::dot(p - a, normal);
+                    if (distance > margin || distance < -margin)
+                        continue;
+                    if (std::abs(distance) < bestDistance[index])
+                    {
+                        bestDistance[index] = std::abs(distance);
+                        bestEdge[index] = uint32_t(e);
+                        bestSide[index] = side;
+                    }
+                }
             }
         }
+    }
 
-        SoftSoftCollisionConstraint constraint;
-        constraint.softBodyA = &bodyA;
-        constraint.softBodyB = &bodyB;
-        constraint.pointIndex = indexA;
-        constraint.edgePointIndex0 = shapeB[nearestEdge];
-        constraint.edgePointIndex1 = shapeB[(nearestEdge + 1) % shapeB.size()];
-        constraint.compliance = compliance;
-        constraint.frictionStatic = frictionStatic;
-        constraint.frictionKinetic = frictionKinetic;
-        outConstraints.push_back(constraint);
+    for (uint32_t index : points)
+    {
+        if (bestEdge[index] == NOT_IN_SHAPE)
+            continue;
+        PushSoftSoftCollision(body, body, index, bestEdge[index], compliance, frictionStatic, frictionKinetic, bestSide[index], outConstraints);
+        outConstraints.back().thickness = thickness;
     }
 }
 
+// total order over contacts: a point collides with at most one edge of a given body
+bool ContactOrderLess(const SoftSoftCollisionConstraint &a, const SoftSoftCollisionConstraint &b)
+{
+    uint32_t pairA = std::min(a.bodyIndexA, a.bodyIndexB);
+    uint32_t pairB = std::min(b.bodyIndexA, b.bodyIndexB);
+    if (pairA != pairB)
+        return pairA < pairB;
+    pairA = std::max(a.bodyIndexA, a.bodyIndexB);
+    pairB = std::max(b.bodyIndexA, b.bodyIndexB);
+    if (pairA != pairB)
+        return pairA < pairB;
+    if (a.bodyIndexA != b.bodyIndexA)
+        return a.bodyIndexA < b.bodyIndexA;
+    return a.pointIndex < b.pointIndex;
+}
 
-void SolveSoftSoftCollisionConstraint(
-    SoftSoftCollisionConstraint &constraint,
-    float dt)
+void BuildContactBatches(const std::vector<std::shared_ptr<SoftBody>> &softBodies,
+                         const std::vector<SoftSoftCollisionConstraint> &constraints,
+                         float dt,
+                         ContactBatches &batches)
 {
-    auto &p = constraint.softBodyA->pointMasses.positions[constraint.pointIndex];
-    auto &p_prev = constraint.softBodyA->pointMasses.prevPositions[constraint.pointIndex];
-    auto p_w = constraint.softBodyA->pointMasses.inverseMasses[constraint.pointIndex];
+    constexpr size_t W = CONTACT_BATCH_WIDTH;
 
-    auto &e0 = constraint.softBodyB->pointMasses.positions[constraint.edgePointIndex0];
-    auto &e1 = constraint.softBodyB->pointMasses.positions[constraint.edgePointIndex1];
-    auto e0_w = constraint.softBodyB->pointMasses.inverseMasses[constraint.edgePointIndex0];
-    auto e1_w = constraint.softBodyB->pointMasses.inverseMasses[constraint.edgePointIndex1];
+    // greedy coloring over scene-wide particle ids, as in ColorAngleConstraints; pinned particles
+    // never move, so they may repeat inside a color. Color 63 takes the overflow and is not independent.
+    std::vector<uint32_t> &firstParticle = batches.bodyFirstParticle;
+    firstParticle.resize(softBodies.size() + 1);
+    firstParticle[0] = 0;
+    for (size_t b = 0; b < softBodies.size(); ++b)
+        firstParticle[b + 1] = firstParticle[b] + uint32_t(softBodies[b]->pointMasses.positions.size());
+    batches.usedColors.assign(firstParticle.back(), 0);
 
-    glm::vec2 edge = e1 - e0;
-    float edgeLengthSq = glm::dot(edge, edge);
-    if (edgeLengthSq < 1e-6f)
-        return;
+    std::vector<uint32_t> &colors = batches.colors;
+    colors.resize(constraints.size());
+    uint32_t colorCounts[64] = {};
+    for (size_t ci = 0; ci < constraints.size(); ++ci)
+    {
+        const SoftSoftCollisionConstraint &c = constraints[ci];
+        const PointMasses &pmA = c.softBodyA->pointMasses;
+        const PointMasses &pmB = c.softBodyB->pointMasses;
+        uint32_t particles[3];
+        uint32_t particleCount = 0;
+        if (pmA.inverseMasses[c.pointIndex] > 0.0f)
+            particles[particleCount++] = firstParticle[c.bodyIndexA] + c.pointIndex;
+        if (pmB.inverseMasses[c.edgePointIndex0] > 0.0f)
+            particles[particleCount++] = firstParticle[c.bodyIndexB] + c.edgePointIndex0;
+        if (pmB.inverseMasses[c.edgePointIndex1] > 0.0f)
+            particles[particleCount++] = firstParticle[c.bodyIndexB] + c.edgePointIndex1;
 
-    float t = glm::clamp(glm::dot(p - e0, edge) / edgeLengthSq, 0.0f, 1.0f);
-    glm::vec2 closestPoint = e0 + t * edge;
+        uint64_t used = 0;
+        for (uint32_t k = 0; k < particleCount; ++k)
+            used |= batches.usedColors[particles[k]];
+        uint32_t color = 0;
+        while (color < 63 && (used & (uint64_t(1) << color)))
+            ++color;
 
-    glm::vec2 n = p - closestPoint;
-    float С = glm::length(n);
-    if (С < 1e-6f)
-        return;
-    n /= С;
+        colors[ci] = color;
+        colorCounts[color]++;
+        for (uint32_t k = 0; k < particleCount; ++k)
+            batches.usedColors[particles[k]] |= uint64_t(1) << color;
+    }
 
-    glm::vec2 grad_p = n;
-    glm::vec2 grad_e0 = -n * (1.0f - t);
-    glm::vec2 grad_e1 = -n * t;
+    // every color is cut into batches of W, the overflow color into batches of one
+    batches.batchCount = 0;
+    uint32_t colorBatchStart[64];
+    for (uint32_t color = 0; color < 64; ++color)
+    {
+        colorBatchStart[color] = uint32_t(batches.batchCount);
+        batches.batchCount += color < 63 ? (colorCounts[color] + W - 1) / W : colorCounts[color];
+    }
 
-    float w_sum = p_w + e0_w * (1.0f - t) * (1.0f - t) + e1_w * t * t;
-    if (w_sum < 1e-6f)
-        return;
+    size_t slots = batches.batchCount * W;
+    batches.point.assign(slots, &batches.padding);
+    batches.edge0.assign(slots, &batches.padding);
+    batches.edge1.assign(slots, &batches.padding);
+    batches.contact.assign(slots, CONTACT_BATCH_PADDING);
+
+    uint32_t colorFill[64] = {};
+    for (size_t ci = 0; ci < constraints.size(); ++ci)
+    {
+        const SoftSoftCollisionConstraint &c = constraints[ci];
+        uint32_t color = colors[ci];
+        uint32_t n = colorFill[color]++;
+        size_t k = color < 63 ? colorBatchStart[color] * W + n : (colorBatchStart[color] + n) * W;
+
+        batches.point[k] = &c.softBodyA->pointMasses.positions[c.pointIndex];
+        batches.edge0[k] = &c.softBodyB->pointMasses.positions[c.edgePointIndex0];
+        batches.edge1[k] = &c.softBodyB->pointMasses.positions[c.edgePointIndex1];
+        batches.contact[k] = uint32_t(ci);
+    }
+
+    GatherContactBatches(constraints, dt, batches);
+}
+
+void GatherContactBatches(const std::vector<SoftSoftCollisionConstraint> &constraints, float dt, ContactBatches &batches)
+{
+    size_t slots = batches.contact.size();
+    batches.pointPrevX.assign(slots, 0.0f);
+    batches.pointPrevY.assign(slots, 0.0f);
+    batches.edge0PrevX.assign(slots, 0.0f);
+    batches.edge0PrevY.assign(slots, 0.0f);
+    batches.edge1PrevX.assign(slots, 0.0f);
+    batches.edge1PrevY.assign(slots, 0.0f);
+    batches.pointW.assign(slots, 0.0f);
+    batches.edge0W.assign(slots, 0.0f);
+    batches.edge1W.assign(slots, 0.0f);
+    batches.alphaTilde.assign(slots, 0.0f);
+    batches.frictionStatic.assign(slots, 0.0f);
+    batches.normalSign.assign(slots, 0.0f);
+    batches.thickness.assign(slots, 0.0f);
+    batches.lambda.assign(slots, 0.0f);
+
+    for (size_t k = 0; k < slots; ++k)
+    {
+        if (batches.contact[k] == CONTACT_BATCH_PADDING)
+            continue;
+        const SoftSoftCollisionConstraint &c = constraints[batches.contact[k]];
+        const PointMasses &pmA = c.softBodyA->pointMasses;
+        const PointMasses &pmB = c.softBodyB->pointMasses;
 
-    float alphaTilde = constraint.compliance / (dt * dt);
-    float deltaLambda = (-С - alphaTilde * constraint.lambda) / (w_sum + alphaTilde);
-    constraint.lambda += deltaLambda;
+        batches.pointPrevX[k] = pmA.prevPositions[c.pointIndex].x;
+        batches.pointPrevY[k] = pmA.prevPositions[c.pointIndex].y;
+        batches.edge0PrevX[k] = pmB.prevPositions[c.edgePointIndex0].x;
+        batches.edge0PrevY[k] = pmB.prevPositions[c.edgePointIndex0].y;
+        batches.edge1PrevX[k] = pmB.prevPositions[c.edgePointIndex1].x;
+        batches.edge1PrevY[k] = pmB.prevPositions[c.edgePointIndex1].y;
+        batches.pointW[k] = pmA.inverseMasses[c.pointIndex];
+        batches.edge0W[k] = pmB.inverseMasses[c.edgePointIndex0];
+        batches.edge1W[k] = pmB.inverseMasses[c.edgePointIndex1];
+        batches.alphaTilde[k] = c.compliance / (dt * dt);
+        batches.frictionStatic[k] = c.frictionStatic;
+        batches.normalSign[k] = c.normalSign;
+        batches.thickness[k] = c.thickness;
+    }
+}
+
+// XPBD point-edge contact with static friction over one padded batch; padding and degenerate lanes
+// get a zero correction. The scalar lane loop is the reference the SSE2 path must match.
+static void SolveContactBatch(ContactBatches &batches, size_t begin)
+{
+    constexpr size_t W = CONTACT_BATCH_WIDTH;
+    float px[W], py[W], e0x[W], e0y[W], e1x[W], e1y[W];
+    float dpx[W], dpy[W], de0x[W], de0y[W], de1x[W], de1y[W];
+
+    glm::vec2 *const *point = batches.point.data() + begin;
+    glm::vec2 *const *edge0 = batches.edge0.data() + begin;
+    glm::vec2 *const *edge1 = batches.edge1.data() + begin;
+    for (size_t k = 0; k < W; ++k)
+    {
+        px[k] = point[k]->x;
+        py[k] = point[k]->y;
+        e0x[k] = edge0[k]->x;
+        e0y[k] = edge0[k]->y;
+        e1x[k] = edge1[k]->x;
+        e1y[k] = edge1[k]->y;
+    }
+
+    const float *pw = batches.pointW.data() + begin;
+    const float *e0w = batches.edge0W.data() + begin;
+    const float *e1w = batches.edge1W.data() + begin;
+    const float *ppx = batches.pointPrevX.data() + begin;
+    const float *ppy = batches.pointPrevY.data() + begin;
+    const float *pe0x = batches.edge0PrevX.data() + begin;
+    const float *pe0y = batches.edge0PrevY.data() + begin;
+    const float *pe1x = batches.edge1PrevX.data() + begin;
+    const float *pe1y = batches.edge1PrevY.data() + begin;
+    const float *alpha = batches.alphaTilde.data() + begin;
+    const float *friction = batches.frictionStatic.data() + begin;
+    const float *sign = batches.normalSign.data() + begin;
+    const float *thickness = batches.thickness.data() + begin;
+    float *lambda = batches.lambda.data() + begin;
+#ifdef CONTACT_SOLVER_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 epsilon = _mm_set1_ps(1e-6f);
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    for (size_t k = 0; k < W; k += 4)
+    {
+        __m128 PX = _mm_loadu_ps(px + k), PY = _mm_loadu_ps(py + k);
+        __m128 E0X = _mm_loadu_ps(e0x + k), E0Y = _mm_loadu_ps(e0y + k);
+        __m128 E1X = _mm_loadu_ps(e1x + k), E1Y = _mm_loadu_ps(e1y + k);
+        __m128 PW = _mm_loadu_ps(pw + k), E0W = _mm_loadu_ps(e0w + k), E1W = _mm_loadu_ps(e1w + k);
+        __m128 alphaTilde = _mm_loadu_ps(alpha + k);
+        __m128 lambdaK = _mm_loadu_ps(lambda + k);
 
-    p += p_w * deltaLambda * grad_p;
-    e0 += e0_w * deltaLambda * grad_e0;
-    e1 += e1_w * deltaLambda * grad_e1;
+        __m128 ex = _mm_sub_ps(E1X, E0X);
+        __m128 ey = _mm_sub_ps(E1Y, E0Y);
+        __m128 edgeLengthSq = _mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey));
+        __m128 t = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(PX, E0X), ex), _mm_mul_ps(_mm_sub_ps(PY, E0Y), ey));
+        t = _mm_div_ps(t, _mm_max_ps(edgeLengthSq, epsilon));
+        __m128 inSpan = _mm_and_ps(_mm_cmpge_ps(t, zero), _mm_cmple_ps(t, one));
+        t = _mm_min_ps(_mm_max_ps(t, zero), one);
+        __m128 dx = _mm_sub_ps(PX, _mm_add_ps(E0X, _mm_mul_ps(t, ex)));
+        __m128 dy = _mm_sub_ps(PY, _mm_add_ps(E0Y, _mm_mul_ps(t, ey)));
+        __m128 C = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+        __m128 invC = _mm_div_ps(one, _mm_max_ps(C, epsilon));
+        __m128 nx = _mm_mul_ps(dx, invC);
+        __m128 ny = _mm_mul_ps(dy, invC);
+        __m128 active = _mm_cmpge_ps(C, epsilon);
 
-    // Static friction
-    glm::vec2 tangent = glm::vec2(-n.y, n.x);
-    glm::vec2 p_disp = p - p_prev;
+        // speculative lanes: signed distance along the outward normal, active while negative and
+        // alongside the edge; past its ends the point may be sliding round a corner of the body
+        __m128 SG = _mm_loadu_ps(sign + k);
+        __m128 speculative = _mm_cmpneq_ps(SG, zero);
+        __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(edgeLengthSq, epsilon)));
+        __m128 onx = _mm_mul_ps(_mm_mul_ps(SG, ey), invLength);
+        __m128 ony = _mm_sub_ps(zero, _mm_mul_ps(_mm_mul_ps(SG, ex), invLength));
+        __m128 signedC = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(dx, onx), _mm_mul_ps(dy, ony)), _mm_loadu_ps(thickness + k));
+        nx = _mm_or_ps(_mm_and_ps(speculative, onx), _mm_andnot_ps(speculative, nx));
+        ny = _mm_or_ps(_mm_and_ps(speculative, ony), _mm_andnot_ps(speculative, ny));
+        C = _mm_or_ps(_mm_and_ps(speculative, signedC), _mm_andnot_ps(speculative, C));
+        active = _mm_or_ps(_mm_and_ps(speculative, _mm_and_ps(_mm_cmplt_ps(signedC, zero), inSpan)), _mm_andnot_ps(speculative, active));
 
-    glm::vec2 e0_prev = constraint.softBodyB->pointMasses.prevPositions[constraint.edgePointIndex0];
-    glm::vec2 e1_prev = constraint.softBodyB->pointMasses.prevPositions[constraint.edgePointIndex1];
-    glm::vec2 e0_disp = e0 - e0_prev;
-    glm::vec2 e1_disp = e1 - e1_prev;
+        __m128 s = _mm_sub_ps(one, t);
+        __m128 wSum = _mm_add_ps(PW, _mm_add_ps(_mm_mul_ps(E0W, _mm_mul_ps(s, s)), _mm_mul_ps(E1W, _mm_mul_ps(t, t))));
 
-    glm::vec2 e_disp = e0_disp * (1.0f - t) + e1_disp * t;
-    glm::vec2 relative_disp = p_disp - e_disp;
-    float tangential_disp = glm::dot(relative_disp, tangent);
+        __m128 valid = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edgeLengthSq, epsilon), active), _mm_cmpge_ps(wSum, epsilon));
+        __m128 dl = _mm_sub_ps(_mm_sub_ps(zero, C), _mm_mul_ps(alphaTilde, lambdaK));
+        dl = _mm_and_ps(valid, _mm_div_ps(dl, _mm_max_ps(_mm_add_ps(wSum, alphaTilde), epsilon)));
+        _mm_storeu_ps(lambda + k, _mm_add_ps(lambdaK, dl));
 
-    float max_static_friction = constraint.frictionStatic * fabs(deltaLambda);
+        __m128 pointStep = _mm_mul_ps(PW, dl);
+        __m128 edge0Step = _mm_mul_ps(E0W, _mm_mul_ps(dl, s));
+        __m128 edge1Step = _mm_mul_ps(E1W, _mm_mul_ps(dl, t));
+        __m128 npx = _mm_add_ps(PX, _mm_mul_ps(pointStep, nx));
+        __m128 npy = _mm_add_ps(PY, _mm_mul_ps(pointStep, ny));
+        __m128 ne0x = _mm_sub_ps(E0X, _mm_mul_ps(edge0Step, nx));
+        __m128 ne0y = _mm_sub_ps(E0Y, _mm_mul_ps(edge0Step, ny));
+        __m128 ne1x = _mm_sub_ps(E1X, _mm_mul_ps(edge1Step, nx));
+        __m128 ne1y = _mm_sub_ps(E1Y, _mm_mul_ps(edge1Step, ny));
 
-    float tangential_correction = glm::clamp(-tangential_disp, -max_static_friction, max_static_friction);
+        // static friction on the displacement relative to the edge
+        __m128 tx = _mm_sub_ps(zero, ny), ty = nx;
+        __m128 rx = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(npx, _mm_loadu_ps(ppx + k)),
+                                          _mm_mul_ps(s, _mm_sub_ps(ne0x, _mm_loadu_ps(pe0x + k)))),
+                               _mm_mul_ps(t, _mm_sub_ps(ne1x, _mm_loadu_ps(pe1x + k))));
+        __m128 ry = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(npy, _mm_loadu_ps(ppy + k)),
+                                          _mm_mul_ps(s, _mm_sub_ps(ne0y, _mm_loadu_ps(pe0y + k)))),
+                               _mm_mul_ps(t, _mm_sub_ps(ne1y, _mm_loadu_ps(pe1y + k))));
+        __m128 maxFriction = _mm_mul_ps(_mm_loadu_ps(friction + k), _mm_andnot_ps(signBit, dl));
+        __m128 correction = _mm_sub_ps(zero, _mm_add_ps(_mm_mul_ps(rx, tx), _mm_mul_ps(ry, ty)));
+        correction = _mm_min_ps(_mm_max_ps(correction, _mm_sub_ps(zero, maxFriction)), maxFriction);
+        correction = _mm_div_ps(correction, _mm_max_ps(wSum, epsilon));
+        __m128 ctx = _mm_mul_ps(correction, tx), cty = _mm_mul_ps(correction, ty);
 
-    p += p_w / w_sum * tangential_correction * tangent;
-    e0 -= e0_w * (1.0f - t) / w_sum * tangential_correction * tangent;
-    e1 -= e1_w * t / w_sum * tangential_correction * tangent;
+        _mm_storeu_ps(dpx + k, _mm_sub_ps(_mm_add_ps(npx, _mm_mul_ps(PW, ctx)), PX));
+        _mm_storeu_ps(dpy + k, _mm_sub_ps(_mm_add_ps(npy, _mm_mul_ps(PW, cty)), PY));
+        _mm_storeu_ps(de0x + k, _mm_sub_ps(_mm_sub_ps(ne0x, _mm_mul_ps(_mm_mul_ps(E0W, s), ctx)), E0X));
+        _mm_storeu_ps(de0y + k, _mm_sub_ps(_mm_sub_ps(ne0y, _mm_mul_ps(_mm_mul_ps(E0W, s), cty)), E0Y));
+        _mm_storeu_ps(de1x + k, _mm_sub_ps(_mm_sub_ps(ne1x, _mm_mul_ps(_mm_mul_ps(E1W, t), ctx)), E1X));
+        _mm_storeu_ps(de1y + k, _mm_sub_ps(_mm_sub_ps(ne1y, _mm_mul_ps(_mm_mul_ps(E1W, t), cty)), E1Y));
+    }
+#else
+    for (size_t k = 0; k < W; ++k)
+    {
+        float ex = e1x[k] - e0x[k];
+        float ey = e1y[k] - e0y[k];
+        float edgeLengthSq = ex * ex + ey * ey;
+        float t = ((px[k] - e0x[k]) * ex + (py[k] - e0y[k]) * ey) / (edgeLengthSq > 1e-6f ? edgeLengthSq : 1e-6f);
+        bool inSpan = t >= 0.0f && t <= 1.0f;
+        t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+        float dx = px[k] - (e0x[k] + t * ex);
+        float dy = py[k] - (e0y[k] + t * ey);
+        float C = std::sqrt(dx * dx + dy * dy);
+        float invC = 1.0f / (C > 1e-6f ? C : 1e-6f);
+        float nx = dx * invC;
+        float ny = dy * invC;
+        bool active = C >= 1e-6f;
+        if (sign[k] != 0.0f)
+        {
+            // speculative: signed distance along the outward normal, active while negative and
+            // alongside the edge
+            float invLength = 1.0f / std::sqrt(edgeLengthSq > 1e-6f ? edgeLengthSq : 1e-6f);
+            nx = sign[k] * ey * invLength;
+            ny = 0.0f - sign[k] * ex * invLength;
+            C = dx * nx + dy * ny - thickness[k];
+            active = C < 0.0f && inSpan;
+        }
+        float s = 1.0f - t;
+        float wSum = pw[k] + (e0w[k] * (s * s) + e1w[k] * (t * t));
+
+        float valid = float(edgeLengthSq >= 1e-6f) * float(active) * float(wSum >= 1e-6f);
+        float dl = valid * ((-C - alpha[k] * lambda[k]) / (wSum + alpha[k] > 1e-6f ? wSum + alpha[k] : 1e-6f));
+        lambda[k] += dl;
+
+        float pointStep = pw[k] * dl;
+        float edge0Step = e0w[k] * (dl * s);
+        float edge1Step = e1w[k] * (dl * t);
+        float npx = px[k] + pointStep * nx;
+        float npy = py[k] + pointStep * ny;
+        float ne0x = e0x[k] - edge0Step * nx;
+        float ne0y = e0y[k] - edge0Step * ny;
+        float ne1x = e1x[k] - edge1Step * nx;
+        float ne1y = e1y[k] - edge1Step * ny;
+
+        // static friction on the displacement relative to the edge
+        float tx = -ny, ty = nx;
+        float rx = (npx - ppx[k]) - s * (ne0x - pe0x[k]) - t * (ne1x - pe1x[k]);
+        float ry = (npy - ppy[k]) - s * (ne0y - pe0y[k]) - t * (ne1y - pe1y[k]);
+        float maxFriction = friction[k] * std::abs(dl);
+        float correction = -(rx * tx + ry * ty);
+        correction = correction < -maxFriction ? -maxFriction : (correction > maxFriction ? maxFriction : correction);
+        correction /= wSum > 1e-6f ? wSum : 1e-6f;
+
+        float ctx = correction * tx, cty = correction * ty;
+
+        dpx[k] = npx + pw[k] * ctx - px[k];
+        dpy[k] = npy + pw[k] * cty - py[k];
+        de0x[k] = ne0x - e0w[k] * s * ctx - e0x[k];
+        de0y[k] = ne0y - e0w[k] * s * cty - e0y[k];
+        de1x[k] = ne1x - e1w[k] * t * ctx - e1x[k];
+        de1y[k] = ne1y - e1w[k] * t * cty - e1y[k];
+    }
+
+#endif
+
+    // deltas, so lanes sharing a pinned particle or the padding leave it untouched
+    for (size_t k = 0; k < W; ++k)
+    {
+        *point[k] += glm::vec2(dpx[k], dpy[k]);
+        *edge0[k] += glm::vec2(de0x[k], de0y[k]);
+        *edge1[k] += glm::vec2(de1x[k], de1y[k]);
+    }
+}
+
+void SolveContactBatches(ContactBatches &batches)
+{
+    for (size_t b = 0; b < batches.batchCount; ++b)
+        SolveContactBatch(batches, b * CONTACT_BATCH_WIDTH);
 }
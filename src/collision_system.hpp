@@ -1,6 +1,8 @@
 #pragma once
 #include "soft_body.hpp"
 #include "glm/glm.hpp"
+#include <memory>
+#include <vector>
 
 struct SoftSoftCollisionConstraint
 {
@@ -9,18 +11,145 @@ struct SoftSoftCollisionConstraint
     uint32_t pointIndex;
     uint32_t edgePointIndex0;
     uint32_t edgePointIndex1;
+    uint32_t edgeIndex = 0; // edge of softBodyB's collisionShape, edgePointIndex0 -> edgePointIndex1
+    uint32_t bodyIndexA = 0; // positions in PhysicsScene::softBodies, for the canonical contact order
+    uint32_t bodyIndexB = 0;
     float compliance = 0.0f;
     float lambda = 0.0f;
 
     float frictionStatic = 0.5f;
     float frictionKinetic = 0.3f;
+
+    // 0: penetration contact, pushes the point onto the edge. +-1: speculative contact, one-sided
+    // along normalSign * Perp2D(edge) (the outward normal) and only active while the point is behind the edge
+    float normalSign = 0.0f;
+    // signed contacts: distance kept between the point and the edge
+    float thickness = 0.0f;
+};
+
+struct StaticEdgeGrid
+{
+    glm::vec2 min, max;
+    int axis;       // 0: cells are columns along x, 1: rows along y
+    float cellSize;
+    float orientation; // 1 if collisionShape winds counter-clockwise, -1 otherwise
+    std::vector<uint32_t> cellStarts; // cellCount + 1 offsets into cellEdges
+    std::vector<uint32_t> cellEdges;  // edge i is collisionShape[i] -> collisionShape[i + 1]
+};
+
+std::shared_ptr<const StaticEdgeGrid> BuildStaticEdgeGrid(const SoftBody &softBody);
+bool PointInStaticGrid(const glm::vec2 &point, const std::vector<glm::vec2> &positions, const std::vector<uint32_t> &shape, const StaticEdgeGrid &grid);
+uint32_t NearestEdgeInStaticGrid(const glm::vec2 &point, const std::vector<glm::vec2> &positions, const std::vector<uint32_t> &shape, const StaticEdgeGrid &grid);
+
+// collisionShape's signed distance (negative inside), gradient and nearest edge sampled on a grid in the
+// rest frame: the rest centroid of the shape points at the origin. A body is placed by the best-fit
+// rotation of its shape points onto their rest offsets, as in shape matching, so the field only
+// describes bodies that stay close to their rest shape.
+struct SignedDistanceField
+{
+    glm::vec2 origin; // rest frame position of sample (0, 0)
+    float cellSize;
+    int width, height;
+    std::vector<float> distances;       // [y * width + x]
+    std::vector<glm::vec2> gradients;   // unit, pointing away from the shape
+    std::vector<uint32_t> nearestEdges; // edge i is collisionShape[i] -> collisionShape[i + 1]
+    std::vector<glm::vec2> restOffsets; // per collisionShape entry, from the rest centroid
+};
+
+struct SignedDistanceSample
+{
+    float distance;
+    glm::vec2 gradient;
+    uint32_t nearestEdge;
+    bool inGrid; // false: clamped to the border, distance is only an upper bound
+};
+
+// shape must outline the body in restPositions; the grid is padded by a few cells round the shape
+std::shared_ptr<const SignedDistanceField> BuildSignedDistanceField(const std::vector<glm::vec2> &restPositions, const std::vector<uint32_t> &shape, float cellSize);
+// bilinear in distance and gradient, nearest sample for the edge; point in the rest frame
+SignedDistanceSample SampleSignedDistanceField(const SignedDistanceField &field, const glm::vec2 &localPoint);
+
+struct BodyBounds
+{
+    glm::vec2 min, max;
 };
 
+// bounds of every particle; a point can only collide with a body whose bounds contain it.
+// Swept bounds also cover prevPositions, for continuous detection; a speculative time grows them
+// by the distance the fastest particle covers in it.
+BodyBounds ComputeBodyBounds(const SoftBody &softBody, bool swept = false, float speculativeTime = 0.0f);
+inline bool BoundsOverlap(const BodyBounds &a, const BodyBounds &b)
+{
+    return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y && b.min.y <= a.max.y;
+}
+
+// Contact edges of the last detection, per (point, body pair). Nearest-edge searches start from the
+// cached edge and walk to neighbouring edges while they get closer, instead of scanning the shape.
+struct NearestEdgeCache
+{
+    struct Entry
+    {
+        const SoftBody *bodyA;
+        const SoftBody *bodyB;
+        uint32_t pointIndex;
+        uint32_t edgeIndex;
+    };
+    std::vector<Entry> entries; // sorted by bodyA, bodyB, pointIndex
+};
+
+void BuildNearestEdgeCache(const std::vector<SoftSoftCollisionConstraint> &constraints, NearestEdgeCache &cache);
+
 void DetectSoftSoftCollisions(
     SoftBody &softBodyA,
     SoftBody &softBodyB,
     float compliance,
     float frictionStatic,
     float frictionKinetic,
-    std::vector<SoftSoftCollisionConstraint> &outConstraints);
-void SolveSoftSoftCollisionConstraint(SoftSoftCollisionConstraint &constraint, float dt);
+    std::vector<SoftSoftCollisionConstraint> &outConstraints,
+    bool continuous = false,
+    float speculativeTime = 0.0f, // > 0: speculative contacts for points that may touch within that time
+    const NearestEdgeCache *edgeCache = nullptr);
+// contacts of the body's collision points with its own collisionShape, found through a spatial hash of
+// the points; points next to an edge along the outline are skipped. Contacts are signed and keep a
+// point a thickness away from the edge, on the side it started the substep on.
+void DetectSelfCollisions(
+    SoftBody &body,
+    float compliance,
+    float frictionStatic,
+    float frictionKinetic,
+    std::vector<SoftSoftCollisionConstraint> &outConstraints,
+    float speculativeTime = 0.0f);
+bool ContactOrderLess(const SoftSoftCollisionConstraint &a, const SoftSoftCollisionConstraint &b);
+
+const size_t CONTACT_BATCH_WIDTH = 8;
+const uint32_t CONTACT_BATCH_PADDING = 0xffffffffu;
+
+// Contacts compiled for SolveContactBatches: SoA slots, CONTACT_BATCH_WIDTH per batch, with pre-gathered
+// inverse masses and previous positions. Contacts in one batch share no dynamic particle, so a batch is
+// gathered, solved lane-wise and scattered without write conflicts. Unused slots point at `padding`.
+// Particle pointers stay valid while no body is resized.
+struct ContactBatches
+{
+    size_t batchCount = 0;
+    std::vector<glm::vec2 *> point, edge0, edge1;
+    std::vector<float> pointPrevX, pointPrevY, edge0PrevX, edge0PrevY, edge1PrevX, edge1PrevY;
+    std::vector<float> pointW, edge0W, edge1W;
+    std::vector<float> alphaTilde, frictionStatic, normalSign, thickness, lambda;
+    std::vector<uint32_t> contact; // source constraint of every slot, CONTACT_BATCH_PADDING if unused
+    glm::vec2 padding = glm::vec2(0.0f);
+
+    // coloring scratch
+    std::vector<uint32_t> bodyFirstParticle;
+    std::vector<uint64_t> usedColors;
+    std::vector<uint32_t> colors;
+};
+
+// bodyIndexA/B of every contact index softBodies
+void BuildContactBatches(const std::vector<std::shared_ptr<SoftBody>> &softBodies,
+                         const std::vector<SoftSoftCollisionConstraint> &constraints,
+                         float dt,
+                         ContactBatches &batches);
+// re-reads previous positions, masses and parameters of the same constraints and clears lambdas, for
+// contacts kept over several substeps
+void GatherContactBatches(const std::vector<SoftSoftCollisionConstraint> &constraints, float dt, ContactBatches &batches);
+void SolveContactBatches(ContactBatches &batches);
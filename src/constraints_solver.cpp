@@ -1,16 +1,18 @@
 #include "constraints_solver.hpp"
 #include "soft_body.hpp"
 #include "utils.hpp"
-#include "renderer.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
-#include <SFML/Graphics.hpp>
 #include <glm/gtx/norm.hpp>
 
-void SolveDistanceConstraints(PointMasses &pm, std::vector<DistanceConstraint> &constraints, float dt)
+void SolveDistanceConstraints(PointMasses &pm, const std::vector<DistanceConstraint> &constraints, std::vector<float> &lambdas, float dt)
 {
-    for (auto &c : constraints)
+    for (size_t ci = 0; ci < constraints.size(); ++ci)
     {
+        const auto &c = constraints[ci];
+        float &lambda = lambdas[ci];
         auto &p1 = pm.positions[c.i1];
         auto &p2 = pm.positions[c.i2];
 
@@ -29,96 +31,161 @@ void SolveDistanceConstraints(PointMasses &pm, std::vector<DistanceConstraint> &
         float denom = w1 + w2 + alphaTilde;
         if (denom < 1e-6f)
             continue;
-        float deltaLambda = (-C - alphaTilde * c.lambda) / denom;
-        c.lambda += deltaLambda;
+        float deltaLambda = (-C - alphaTilde * lambda) / denom;
+        lambda += deltaLambda;
 
         p1 += w1 * deltaLambda * grad;
         p2 -= w2 * deltaLambda * grad;
     }
 }
 
-void SolveVolumeConstraints(PointMasses &pm, std::vector<VolumeConstraint> &constraints, float dt)
+void SolveVolumeConstraints(PointMasses &pm, const std::vector<VolumeConstraint> &constraints, const std::vector<uint32_t> &indexPool, std::vector<float> &lambdas, float dt)
 {
-    for (auto &c : constraints)
+    for (size_t ci = 0; ci < constraints.size(); ++ci)
     {
-        const auto &indices = c.indices;
-        size_t N = indices.size();
+        const auto &c = constraints[ci];
+        float &lambda = lambdas[ci];
+        const uint32_t *indices = indexPool.data() + c.indices.begin;
+        size_t N = c.indices.count;
+        if (N < 3)
+            continue;
 
-        float volume = ComputePolygonArea(pm.positions, c.indices);
-        float C = volume - c.restVolume;
+        auto &positions = pm.positions;
+        const auto &inverseMasses = pm.inverseMasses;
 
+        // fused pass: area and sum w_i |grad_i|^2 with rolling prev/cur/next, no modulo
+        float area = 0.0f;
         float denom = 0.0f;
-        std::vector<glm::vec2> grads(N);
-
+        glm::vec2 prev = positions[indices[N - 1]];
+        glm::vec2 cur = positions[indices[0]];
         for (size_t i = 0; i < N; ++i)
         {
-            const glm::vec2 &pi_prev = pm.positions[indices[(i + N - 1) % N]];
-            const glm::vec2 &pi_next = pm.positions[indices[(i + 1) % N]];
-
-            glm::vec2 grad = 0.5f * Perp2D(pi_next, pi_prev);
-            grads[i] = grad;
-            denom += pm.inverseMasses[indices[i]] * glm::dot(grad, grad);
+            glm::vec2 next = positions[indices[i + 1 < N ? i + 1 : 0]];
+            glm::vec2 grad = 0.5f * Perp2D(next, prev);
+            area += Cross2D(cur, next);
+            denom += inverseMasses[indices[i]] * glm::dot(grad, grad);
+            prev = cur;
+            cur = next;
         }
+        area *= 0.5f;
 
+        float C = area - c.restVolume;
         float alphaTilde = c.compliance / (dt * dt);
         denom += alphaTilde;
         if (denom < 1e-6f)
             continue;
-        float deltaLambda = (-C - alphaTilde * c.lambda) / denom;
-        c.lambda += deltaLambda;
+        float deltaLambda = (-C - alphaTilde * lambda) / denom;
+        lambda += deltaLambda;
 
+        // apply pass: gradients from pre-correction neighbours
+        glm::vec2 first = positions[indices[0]];
+        prev = positions[indices[N - 1]];
         for (size_t i = 0; i < N; ++i)
         {
-            uint32_t idx = indices[i];
+            glm::vec2 &p = positions[indices[i]];
+            glm::vec2 next = i + 1 < N ? positions[indices[i + 1]] : first;
+            glm::vec2 original = p;
 
-            pm.positions[idx] += pm.inverseMasses[idx] * deltaLambda * grads[i];
+            p += inverseMasses[indices[i]] * deltaLambda * 0.5f * Perp2D(next, prev);
+
+            prev = original;
         }
     }
 }
 
-void SolveAngleConstraints(PointMasses &pm, std::vector<AngleConstraint> &constraints, float dt)
+// constraints in [begin, begin + count) must not share particles
+static void SolveAngleConstraintBatch(PointMasses &pm, const AngleConstraint *batch, float *batchLambdas, size_t count, float dt)
 {
-    for (auto &constraint : constraints)
-    {
-        uint32_t i1 = constraint.i1;
-        uint32_t i2 = constraint.i2;
-        uint32_t i3 = constraint.i3;
+    constexpr size_t W = ANGLE_BATCH_WIDTH;
+    float ax[W], ay[W], bx[W], by[W];
+    float w1[W], w2[W], w3[W];
+    float rc[W], rs[W], alpha[W], lambda[W];
+    float g1x[W], g1y[W], g3x[W], g3y[W], dl[W];
 
-        glm::vec2 &p1 = pm.positions[i1];
-        glm::vec2 &p2 = pm.positions[i2];
-        glm::vec2 &p3 = pm.positions[i3];
-
-        float w1 = pm.inverseMasses[i1];
-        float w2 = pm.inverseMasses[i2];
-        float w3 = pm.inverseMasses[i3];
-
-        glm::vec2 d1 = glm::normalize(p1 - p2);
-        glm::vec2 d2 = glm::normalize(p3 - p2);
-
-        float C = CalculateAngle(p1, p2, p3) - constraint.restAngle;
+    for (size_t k = 0; k < count; ++k)
+    {
+        const AngleConstraint &c = batch[k];
+        const glm::vec2 &p1 = pm.positions[c.i1];
+        const glm::vec2 &p2 = pm.positions[c.i2];
+        const glm::vec2 &p3 = pm.positions[c.i3];
+        ax[k] = p1.x - p2.x;
+        ay[k] = p1.y - p2.y;
+        bx[k] = p3.x - p2.x;
+        by[k] = p3.y - p2.y;
+        w1[k] = pm.inverseMasses[c.i1];
+        w2[k] = pm.inverseMasses[c.i2];
+        w3[k] = pm.inverseMasses[c.i3];
+        rc[k] = c.restRotation.x;
+        rs[k] = c.restRotation.y;
+        alpha[k] = c.compliance / (dt * dt);
+        lambda[k] = batchLambdas[k];
+    }
 
-        glm::vec2 grad_p1 = (1.0f / glm::length(p1 - p2)) * glm::vec2(-d2.y, d2.x);
-        glm::vec2 grad_p3 = (1.0f / glm::length(p3 - p2)) * glm::vec2(d1.y, -d1.x);
-        glm::vec2 grad_p2 = -(grad_p1 + grad_p3);
+    for (size_t k = 0; k < count; ++k)
+    {
+        float dot = ax[k] * bx[k] + ay[k] * by[k];
+        float cross = ax[k] * by[k] - ay[k] * bx[k];
+
+        // angle of (dot, cross) relative to the rest rotation, in [-pi, pi]
+        float C = FastAtan2(cross * rc[k] - dot * rs[k], dot * rc[k] + cross * rs[k]);
+
+        float la2 = ax[k] * ax[k] + ay[k] * ay[k];
+        float lb2 = bx[k] * bx[k] + by[k] * by[k];
+        float invLa2 = la2 > 1e-12f ? 1.0f / la2 : 0.0f;
+        float invLb2 = lb2 > 1e-12f ? 1.0f / lb2 : 0.0f;
+
+        g1x[k] = ay[k] * invLa2;
+        g1y[k] = -ax[k] * invLa2;
+        g3x[k] = -by[k] * invLb2;
+        g3y[k] = bx[k] * invLb2;
+        float g2x = -(g1x[k] + g3x[k]);
+        float g2y = -(g1y[k] + g3y[k]);
+
+        float denom = w1[k] * invLa2 +
+                      w2[k] * (g2x * g2x + g2y * g2y) +
+                      w3[k] * invLb2 +
+                      alpha[k];
+        float valid = (invLa2 > 0.0f && invLb2 > 0.0f && denom > 1e-12f) ? 1.0f : 0.0f;
+        dl[k] = valid * (-C - alpha[k] * lambda[k]) / (denom > 1e-12f ? denom : 1.0f);
+    }
 
-        float invMass = w1 * glm::dot(grad_p1, grad_p1) +
-                        w2 * glm::dot(grad_p2, grad_p2) +
-                        w3 * glm::dot(grad_p3, grad_p3);
+    for (size_t k = 0; k < count; ++k)
+    {
+        const AngleConstraint &c = batch[k];
+        glm::vec2 g1(g1x[k], g1y[k]);
+        glm::vec2 g3(g3x[k], g3y[k]);
+        batchLambdas[k] += dl[k];
+        pm.positions[c.i1] += w1[k] * dl[k] * g1;
+        pm.positions[c.i2] -= w2[k] * dl[k] * (g1 + g3);
+        pm.positions[c.i3] += w3[k] * dl[k] * g3;
+    }
+}
 
-        float alpha = constraint.compliance / (dt * dt);
-        float deltaLambda = (-C - alpha * constraint.lambda) / (invMass + alpha);
-        constraint.lambda += deltaLambda;
+void SolveAngleConstraints(PointMasses &pm, const std::vector<AngleConstraint> &constraints, const std::vector<uint32_t> &colors, std::vector<float> &lambdas, float dt)
+{
+    // stale or missing coloring: plain Gauss-Seidel
+    if (colors.empty() || colors.back() != constraints.size())
+    {
+        for (size_t i = 0; i < constraints.size(); ++i)
+            SolveAngleConstraintBatch(pm, &constraints[i], &lambdas[i], 1, dt);
+        return;
+    }
 
-        p1 += w1 * deltaLambda * grad_p1;
-        p2 += w2 * deltaLambda * grad_p2;
-        p3 += w3 * deltaLambda * grad_p3;
+    for (size_t color = 0; color + 1 < colors.size(); ++color)
+    {
+        // the last color may hold overflow constraints that are not independent
+        size_t width = color < 63 ? ANGLE_BATCH_WIDTH : 1;
+        for (size_t i = colors[color]; i < colors[color + 1]; i += width)
+            SolveAngleConstraintBatch(pm, &constraints[i], &lambdas[i], std::min<size_t>(width, colors[color + 1] - i), dt);
     }
 }
 
-void SolvePinConstraints(PointMasses &pm, std::vector<PinConstraint> &constraints, float dt)
+void SolvePinConstraints(PointMasses &pm, const std::vector<PinConstraint> &constraints, std::vector<float> &lambdas, float dt)
 {
-    for (auto &c : constraints)
+    for (size_t ci = 0; ci < constraints.size(); ++ci)
     {
+        const auto &c = constraints[ci];
+        float &lambda = lambdas[ci];
         glm::vec2 &x = pm.positions[c.index];
         float w = pm.inverseMasses[c.index];
         if (w == 0.0f)
@@ -133,190 +200,102 @@ void SolvePinConstraints(PointMasses &pm, std::vector<PinConstraint> &constraint
 
         float alphaTilde = c.compliance / (dt * dt);
         float denom = w + alphaTilde;
-        float deltaLambda = (-C - alphaTilde * c.lambda) / denom;
-        c.lambda += deltaLambda;
+        float deltaLambda = (-C - alphaTilde * lambda) / denom;
+        lambda += deltaLambda;
 
         x -= w * deltaLambda * grad;
     }
 }
 
-float ComputeAverageAngle(const std::vector<glm::vec2> &startPositions,
-                          const std::vector<glm::vec2> &currentPositions,
-                          const glm::vec2 &startCenter,
-                          const glm::vec2 &currentCenter)
-{
-    float angleSum = 0.0f;
-    size_t count = startPositions.size();
-
-    for (size_t i = 0; i < count; ++i)
-    {
-        glm::vec2 qi = glm::normalize(startPositions[i] - startCenter);
-        glm::vec2 pi = glm::normalize(currentPositions[i] - currentCenter);
-
-        float angle = atan2(pi.y, pi.x) - atan2(qi.y, qi.x);
-        // Приводим угол к [-π, π]
-        angle = fmod(angle + glm::pi<float>(), glm::two_pi<float>()) - glm::pi<float>();
-
-        angleSum += angle;
-    }
-
-    return angleSum / static_cast<float>(count);
-}
-
 void SolveShapeMatchingConstraints(PointMasses &pm,
-                                   std::vector<ShapeMatchingConstraint> &constraints,
+                                   const std::vector<ShapeMatchingConstraint> &constraints,
+                                   const std::vector<uint32_t> &indexPool,
+                                   const std::vector<glm::vec2> &restOffsetPool,
+                                   std::vector<float> &lambdas,
                                    float dt)
 {
-    for (auto &с : constraints)
+    for (size_t ci = 0; ci < constraints.size(); ++ci)
     {
-        std::vector<glm::vec2> currentPositions;
-        for (auto index : с.indices)
-            currentPositions.push_back(pm.positions[index]);
-
-        glm::vec2 currentCenter = ComputeGeometryCenter(currentPositions);
-        glm::vec2 startCenter = ComputeGeometryCenter(с.startPositions);
-
-        float avgAngle = ComputeAverageAngle(с.startPositions, currentPositions, startCenter, currentCenter);
-        glm::mat2 R = RotationMatrixFromAngle2D(-avgAngle);
+        const auto &c = constraints[ci];
+        float &lambda = lambdas[ci];
+        const uint32_t *indices = indexPool.data() + c.indices.begin;
+        const glm::vec2 *restOffsets = restOffsetPool.data() + c.restOffsetsBegin;
+        size_t N = c.indices.count;
+        if (N < 2)
+            continue;
 
-        float wSum = 0;
-        for (auto index : с.indices)
-            wSum += pm.inverseMasses[index];
+        glm::vec2 center(0.0f);
+        for (size_t i = 0; i < N; ++i)
+            center += pm.positions[indices[i]];
+        center /= static_cast<float>(N);
 
-        for (size_t i = 0; i < с.indices.size(); ++i)
+        // Apq = sum (p_i - c) q_i^T
+        float a00 = 0.0f, a01 = 0.0f, a10 = 0.0f, a11 = 0.0f;
+        for (size_t i = 0; i < N; ++i)
         {
-            uint32_t index = с.indices[i];
-            glm::vec2 goal = R * (с.startPositions[i] - startCenter) + currentCenter;
-            Renderer::DrawCircle(pm.positions[index], 2, sf::Color::Red);
-            Renderer::DrawCircle(goal, 2, sf::Color::Green);
-            Renderer::DrawLine(pm.positions[index], goal, sf::Color::Red);
-
-            glm::vec2 correction = goal - pm.positions[index];
-
-            float C = glm::length(correction);
-            if (C > 1e-6f)
-            {
-                glm::vec2 grad = correction / C;
-                float alphaTilde = с.compliance / (dt * dt);
-                float deltaLambda = (-C - alphaTilde * с.lambda) / (wSum + alphaTilde);
-                // с.lambda += deltaLambda;
-
-                pm.positions[index] -= pm.inverseMasses[index] * deltaLambda * grad;
-            }
+            glm::vec2 p = pm.positions[indices[i]] - center;
+            const glm::vec2 &q = restOffsets[i];
+            a00 += p.x * q.x;
+            a01 += p.x * q.y;
+            a10 += p.y * q.x;
+            a11 += p.y * q.y;
         }
-    }
-}
 
-void SolveAccelerationConstraints(PointMasses &pm, std::vector<AccelerationConstraint> &constraints, float dt)
-{
-    for (auto &c : constraints)
-    {
-        for (auto idx : c.indices)
+        // 2D polar decomposition: rotation part of Apq without trig
+        float cosR = a00 + a11;
+        float sinR = a10 - a01;
+        float len = std::sqrt(cosR * cosR + sinR * sinR);
+        if (len < 1e-6f)
         {
-            if (pm.inverseMasses[idx] == 0.0f)
-                continue;
-            glm::vec2 accel = c.acceleration;
-            pm.positions[idx] += accel * dt * dt;
+            cosR = 1.0f;
+            sinR = 0.0f;
         }
-    }
-}
-
-void SolveForceConstraints(PointMasses &pm, std::vector<ForceConstraint> &constraints, float dt)
-{
-    for (auto &c : constraints)
-    {
-        for (auto idx : c.indices)
+        else
         {
-            if (pm.inverseMasses[idx] == 0.0f)
-                continue;
-            glm::vec2 acceleration = c.force * pm.inverseMasses[idx];
-            pm.positions[idx] += acceleration * dt * dt;
+            cosR /= len;
+            sinR /= len;
         }
-    }
-}
 
-void SolveVelocityConstraints(PointMasses &pm, std::vector<VelocityConstraint> &constraints, float dt)
-{
-    for (auto &c : constraints)
-    {
-        for (auto idx : c.indices)
+        glm::mat2 R(cosR, sinR, -sinR, cosR);
+        glm::mat2 T = R;
+        if (c.linearity > 0.0f)
         {
-            if (pm.inverseMasses[idx] == 0.0f)
-                continue;
-            glm::vec2 desiredPos = pm.prevPositions[idx] + c.velocity * dt;
-            glm::vec2 correction = desiredPos - pm.positions[idx];
-            pm.positions[idx] += correction;
+            glm::mat2 A = glm::mat2(a00, a10, a01, a11) * c.restAqqInverse;
+            float det = glm::determinant(A);
+            if (det > 1e-6f)
+                A /= std::sqrt(det);
+            T = c.linearity * A + (1.0f - c.linearity) * R;
         }
-    }
-}
 
-void SolveAngularAccelerationConstraints(PointMasses &pm, std::vector<AngularAccelerationConstraint> &constraints, float dt)
-{
-    for (auto &c : constraints)
-    {
-        for (auto idx : c.indices)
+        float C2 = 0.0f;
+        float denom = 0.0f;
+        for (size_t i = 0; i < N; ++i)
         {
-            if (pm.inverseMasses[idx] == 0.0f)
-                continue;
-
-            float angle = 0.5f * c.acceleration * dt * dt;
-
-            glm::mat2 rotation = glm::mat2(
-                glm::cos(angle), -glm::sin(angle),
-                glm::sin(angle), glm::cos(angle));
-
-            glm::vec2 relativePos = pm.positions[idx] - c.position;
-            pm.positions[idx] = c.position + rotation * relativePos;
+            uint32_t index = indices[i];
+            glm::vec2 d = pm.positions[index] - (T * restOffsets[i] + center);
+            float d2 = glm::dot(d, d);
+            C2 += d2;
+            denom += pm.inverseMasses[index] * d2;
         }
-    }
-}
 
-void SolveAngularForceConstraints(PointMasses &pm, std::vector<AngularForceConstraint> &constraints, float dt)
-{
-    for (auto &c : constraints)
-    {
-        for (auto idx : c.indices)
-        {
-            if (pm.inverseMasses[idx] == 0.0f)
-                continue;
-
-            glm::vec2 relativePos = pm.positions[idx] - c.position;
-            float r_len2 = glm::dot(relativePos, relativePos);
-            if (r_len2 == 0.0f)
-                continue;
-
-            float mass = 1.0f / pm.inverseMasses[idx];
-            float inertia = mass * r_len2;
-            float angularAccel = c.force / inertia;
-
-            float angle = 0.5f * angularAccel * dt * dt;
-
-            glm::mat2 rotation = glm::mat2(
-                glm::cos(angle), -glm::sin(angle),
-                glm::sin(angle), glm::cos(angle));
+        if (C2 < 1e-12f)
+            continue;
 
-            pm.positions[idx] = c.position + rotation * relativePos;
-        }
-    }
-}
+        // C = |x - goal|, grad_i = (x_i - goal_i) / C
+        float C = std::sqrt(C2);
+        float alphaTilde = c.compliance / (dt * dt);
+        denom = denom / C2 + alphaTilde;
+        if (denom < 1e-6f)
+            continue;
+        float deltaLambda = (-C - alphaTilde * lambda) / denom;
+        lambda += deltaLambda;
 
-void SolveAngularVelocityConstraints(PointMasses &pm, std::vector<AngularVelocityConstraint> &constraints, float dt)
-{
-    for (auto &c : constraints)
-    {
-        for (auto idx : c.indices)
+        float scale = deltaLambda / C;
+        for (size_t i = 0; i < N; ++i)
         {
-            if (pm.inverseMasses[idx] == 0.0f)
-                continue;
-
-            float angle = c.velocity * dt;
-
-            glm::mat2 rotation = glm::mat2(
-                glm::cos(angle), -glm::sin(angle),
-                glm::sin(angle), glm::cos(angle));
-
-            glm::vec2 relativePos = pm.positions[idx] - c.position;
-            pm.positions[idx] = c.position + rotation * relativePos;
+            uint32_t index = indices[i];
+            glm::vec2 d = pm.positions[index] - (T * restOffsets[i] + center);
+            pm.positions[index] += pm.inverseMasses[index] * scale * d;
         }
     }
-}
\ No newline at end of file
+}
@@ -1,15 +1,10 @@
 #pragma once
 #include "soft_body.hpp"
 
-void SolveDistanceConstraints(PointMasses &pm, std::vector<DistanceConstraint> &constraints, float dt);
-void SolveVolumeConstraints(PointMasses &pm, std::vector<VolumeConstraint> &constraints, float dt);
-void SolveAngleConstraints(PointMasses &pm, std::vector<AngleConstraint> &constraints, float dt);
-void SolveShapeMatchingConstraints(PointMasses &pm, std::vector<ShapeMatchingConstraint> &constraints, float dt);
-void SolvePinConstraints(PointMasses &pm, std::vector<PinConstraint> &constraints, float dt);
+const size_t ANGLE_BATCH_WIDTH = 8;
 
-void SolveAccelerationConstraints(PointMasses &pm, std::vector<AccelerationConstraint> &constraints, float dt);
-void SolveForceConstraints(PointMasses &pm, std::vector<ForceConstraint> &constraints, float dt);
-void SolveVelocityConstraints(PointMasses &pm, std::vector<VelocityConstraint> &constraints, float dt);
-void SolveAngularAccelerationConstraints(PointMasses &pm, std::vector<AngularAccelerationConstraint> &constraints, float dt);
-void SolveAngularForceConstraints(PointMasses &pm, std::vector<AngularForceConstraint> &constraints, float dt);
-void SolveAngularVelocityConstraints(PointMasses &pm, std::vector<AngularVelocityConstraint> &constraints, float dt);
\ No newline at end of file
+void SolveDistanceConstraints(PointMasses &pm, const std::vector<DistanceConstraint> &constraints, std::vector<float> &lambdas, float dt);
+void SolveVolumeConstraints(PointMasses &pm, const std::vector<VolumeConstraint> &constraints, const std::vector<uint32_t> &indexPool, std::vector<float> &lambdas, float dt);
+void SolveAngleConstraints(PointMasses &pm, const std::vector<AngleConstraint> &constraints, const std::vector<uint32_t> &colors, std::vector<float> &lambdas, float dt);
+void SolveShapeMatchingConstraints(PointMasses &pm, const std::vector<ShapeMatchingConstraint> &constraints, const std::vector<uint32_t> &indexPool, const std::vector<glm::vec2> &restOffsetPool, std::vector<float> &lambdas, float dt);
+void SolvePinConstraints(PointMasses &pm, const std::vector<PinConstraint> &constraints, std::vector<float> &lambdas, float dt);
\ No newline at end of file
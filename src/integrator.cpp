@@ -1,21 +1,164 @@
 #include "integrator.hpp"
 #include "soft_body.hpp"
 
-void Integrate(PointMasses &pm, float dt, const glm::vec2 &gravity)
+#include <cmath>
+
+// displacement of a rotation about pivot, expressed as an acceleration over dt
+static void AccumulateRotation(
+    std::vector<glm::vec2> &accelerations,
+    const std::vector<glm::vec2> &positions,
+    const uint32_t *indices,
+    uint32_t count,
+    const glm::vec2 &pivot,
+    float angle,
+    float dt)
 {
-    for (size_t i = 0; i < pm.positions.size(); ++i)
+    if (angle == 0.0f)
+        return;
+
+    float c = std::cos(angle) - 1.0f;
+    float s = std::sin(angle);
+    float invDt2 = 1.0f / (dt * dt);
+
+    for (uint32_t i = 0; i < count; ++i)
     {
-        if (pm.inverseMasses[i] == 0.0f)
-            continue;
+        uint32_t idx = indices[i];
+        glm::vec2 r = positions[idx] - pivot;
+        accelerations[idx] += glm::vec2(c * r.x - s * r.y, s * r.x + c * r.y) * invDt2;
+    }
+}
 
-        pm.velocities[i] += gravity * dt;
-        pm.prevPositions[i] = pm.positions[i];
-        pm.positions[i] += pm.velocities[i] * dt;
+void AccumulateDriveAccelerations(SoftBody &softBody, float dt, const glm::vec2 &gravity)
+{
+    auto &accelerations = softBody.driveAccelerations;
+    const auto &pm = softBody.pointMasses;
+
+    if (softBody.accelerationConstraints.empty() &&
+        softBody.forceConstraints.empty() &&
+        softBody.VelocityConstraints.empty() &&
+        softBody.angularAccelerationConstraints.empty() &&
+        softBody.angularForceConstraints.empty() &&
+        softBody.angularVelocityConstraints.empty())
+    {
+        accelerations.clear();
+        return;
     }
+
+    accelerations.assign(pm.positions.size(), glm::vec2(0.0f));
+    const uint32_t *pool = softBody.driveIndices.data();
+
+    for (auto &c : softBody.accelerationConstraints)
+        for (uint32_t i = 0; i < c.indices.count; ++i)
+            accelerations[pool[c.indices.begin + i]] += c.acceleration;
+
+    for (auto &c : softBody.forceConstraints)
+        for (uint32_t i = 0; i < c.indices.count; ++i)
+        {
+            uint32_t idx = pool[c.indices.begin + i];
+            accelerations[idx] += c.force * pm.inverseMasses[idx];
+        }
+
+    // velocity drives override the linear drives above, as well as gravity
+    for (auto &c : softBody.VelocityConstraints)
+        for (uint32_t i = 0; i < c.indices.count; ++i)
+        {
+            uint32_t idx = pool[c.indices.begin + i];
+            accelerations[idx] = (c.velocity - pm.velocities[idx]) / dt - gravity;
+        }
+
+    for (auto &c : softBody.angularAccelerationConstraints)
+        AccumulateRotation(accelerations, pm.positions, pool + c.indices.begin, c.indices.count, c.position, 0.5f * c.acceleration * dt * dt, dt);
+
+    // per-point angle is tiny, so the rotation is linearised: a = 0.5 * F * w / |r|^2 * perp(r)
+    for (auto &c : softBody.angularForceConstraints)
+    {
+        for (uint32_t i = 0; i < c.indices.count; ++i)
+        {
+            uint32_t idx = pool[c.indices.begin + i];
+            glm::vec2 r = pm.positions[idx] - c.position;
+            float r_len2 = glm::dot(r, r);
+            if (r_len2 == 0.0f)
+                continue;
+            accelerations[idx] += (0.5f * c.force * pm.inverseMasses[idx] / r_len2) * glm::vec2(-r.y, r.x);
+        }
+    }
+
+    for (auto &c : softBody.angularVelocityConstraints)
+        AccumulateRotation(accelerations, pm.positions, pool + c.indices.begin, c.indices.count, c.position, c.velocity * dt, dt);
 }
 
-void UpdateVelocities(PointMasses &pm, float dt)
+void Integrate(PointMasses &pm, const std::vector<glm::vec2> &driveAccelerations, float dt, const glm::vec2 &gravity)
 {
+    bool hasDrives = !driveAccelerations.empty();
+
+    if (!pm.partitioned)
+    {
+        for (size_t i = 0; i < pm.positions.size(); ++i)
+        {
+            if (pm.inverseMasses[i] == 0.0f)
+                continue;
+
+            glm::vec2 acceleration = hasDrives ? gravity + driveAccelerations[i] : gravity;
+            pm.velocities[i] += acceleration * dt;
+            pm.prevPositions[i] = pm.positions[i];
+            pm.positions[i] += pm.velocities[i] * dt;
+        }
+        return;
+    }
+
+    // partitioned: straight sweep over the dynamic range, pinned points are never touched
+    size_t n = pm.dynamicCount;
+    glm::vec2 *positions = pm.positions.data();
+    glm::vec2 *prevPositions = pm.prevPositions.data();
+    glm::vec2 *velocities = pm.velocities.data();
+
+    if (hasDrives)
+    {
+        const glm::vec2 *accelerations = driveAccelerations.data();
+        for (size_t i = 0; i < n; ++i)
+        {
+            velocities[i] += (gravity + accelerations[i]) * dt;
+            prevPositions[i] = positions[i];
+            positions[i] += velocities[i] * dt;
+        }
+    }
+    else
+    {
+        glm::vec2 dv = gravity * dt;
+        for (size_t i = 0; i < n; ++i)
+        {
+            velocities[i] += dv;
+            prevPositions[i] = positions[i];
+            positions[i] += velocities[i] * dt;
+        }
+    }
+}
+
+// t in (0, 1]: how far the substep has moved from kinematicTransform towards kinematicTarget
+void IntegrateKinematic(SoftBody &softBody, float t, float dt)
+{
+    auto &pm = softBody.pointMasses;
+    const auto &from = softBody.kinematicTransform;
+    const auto &to = softBody.kinematicTarget;
+
+    glm::vec2 position = from.position + (to.position - from.position) * t;
+    float angle = from.angle + (to.angle - from.angle) * t;
+    float c = std::cos(angle);
+    float s = std::sin(angle);
+
     for (size_t i = 0; i < pm.positions.size(); ++i)
+    {
+        const glm::vec2 &local = softBody.kinematicLocalPositions[i];
+        pm.prevPositions[i] = pm.positions[i];
+        pm.positions[i] = position + glm::vec2(c * local.x - s * local.y, s * local.x + c * local.y);
         pm.velocities[i] = (pm.positions[i] - pm.prevPositions[i]) / dt;
+    }
 }
+
+void UpdateVelocities(PointMasses &pm, float dt)
+{
+    size_t n = pm.partitioned ? pm.dynamicCount : pm.positions.size();
+    float invDt = 1.0f / dt;
+    for (size_t i = 0; i < n; ++i)
+        pm.velocities[i] = (pm.positions[i] - pm.prevPositions[i]) * invDt;
+}
\ No newline at end of file
@@ -2,5 +2,7 @@
 #include "soft_body.hpp"
 
 
-void Integrate(PointMasses &pm, float dt, const glm::vec2 &gravity);
+void AccumulateDriveAccelerations(SoftBody &softBody, float dt, const glm::vec2 &gravity);
+void Integrate(PointMasses &pm, const std::vector<glm::vec2> &driveAccelerations, float dt, const glm::vec2 &gravity);
+void IntegrateKinematic(SoftBody &softBody, float t, float dt);
 void UpdateVelocities(PointMasses &pm, float dt);
\ No newline at end of file
@@ -0,0 +1,266 @@
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <exception>
+
+static thread_local const JobSystem *sWorkerOwner = nullptr;
+static thread_local size_t sWorkerIndex = 0;
+
+struct ParallelForContext
+{
+    const std::function<void(size_t, size_t)> *body;
+    std::atomic<size_t> remaining{0};
+    std::mutex errorMutex;
+    std::exception_ptr error;
+};
+
+static void RunParallelForChunk(void *context, size_t begin, size_t end)
+{
+    ParallelForContext &pf = *static_cast<ParallelForContext *>(context);
+    try
+    {
+        (*pf.body)(begin, end);
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(pf.errorMutex);
+        if (!pf.error)
+            pf.error = std::current_exception();
+    }
+    pf.remaining.fetch_sub(1, std::memory_order_release);
+}
+
+JobSystem::JobSystem(size_t workerCount)
+{
+    Start(workerCount);
+}
+
+JobSystem::~JobSystem()
+{
+    Stop();
+}
+
+size_t JobSystem::GetDefaultWorkerCount()
+{
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+size_t JobSystem::GetWorkerIndex() const
+{
+    return sWorkerOwner == this ? sWorkerIndex : 0;
+}
+
+void JobSystem::SetWorkerCount(size_t workerCount)
+{
+    if (workerCount == GetWorkerCount())
+        return;
+    Stop();
+    Start(workerCount);
+}
+
+void JobSystem::Start(size_t workerCount)
+{
+    workerCount = std::max<size_t>(1, workerCount);
+    mQueues.clear();
+    for (size_t i = 0; i < workerCount; ++i)
+        mQueues.push_back(std::make_unique<Queue>());
+    for (size_t i = 1; i < workerCount; ++i)
+        mThreads.emplace_back(&JobSystem::WorkerLoop, this, i);
+}
+
+void JobSystem::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mStopping = true;
+    }
+    mWake.notify_all();
+    for (auto &thread : mThreads)
+        thread.join();
+    mThreads.clear();
+    mStopping = false;
+}
+
+void JobSystem::WorkerLoop(size_t index)
+{
+    sWorkerOwner = this;
+    sWorkerIndex = index;
+
+    while (true)
+    {
+        // spin briefly, Simulate issues several short ParallelFor calls per substep
+        bool ran = false;
+        for (int spin = 0; spin < 64 && !ran; ++spin)
+        {
+            ran = RunOne();
+            if (!ran)
+                std::this_thread::yield();
+        }
+        if (ran)
+            continue;
+
+        std::unique_lock<std::mutex> lock(mSleepMutex);
+        mWake.wait(lock, [this] { return mStopping || mQueuedCount.load() > 0; });
+        if (mStopping && mQueuedCount.load() == 0)
+            return;
+    }
+}
+
+void JobSystem::Push(size_t queue, const Task &task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mQueues[queue]->mutex);
+        mQueues[queue]->tasks.push_back(task);
+    }
+    mQueuedCount.fetch_add(1);
+}
+
+bool JobSystem::TryPop(size_t index, Task &task)
+{
+    if (mQueuedCount.load() == 0)
+        return false;
+
+    {
+        Queue &own = *mQueues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            mQueuedCount.fetch_sub(1);
+            return true;
+        }
+    }
+    for (size_t k = 1; k < mQueues.size(); ++k)
+    {
+        Queue &victim = *mQueues[(index + k) % mQueues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            mQueuedCount.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JobSystem::RunOne()
+{
+    Task task;
+    if (!TryPop(GetWorkerIndex(), task))
+        return false;
+    task.run(task.context, task.begin, task.end);
+    return true;
+}
+
+void JobSystem::RunJob(void *context, size_t, size_t)
+{
+    JobState &state = *static_cast<JobState *>(context);
+    JobHandle keepAlive = std::move(state.self);
+    state.job();
+
+    std::vector<JobHandle> dependents;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.done = true;
+        dependents.swap(state.dependents);
+    }
+    for (auto &dependent : dependents)
+    {
+        if (dependent->pendingDependencies.fetch_sub(1) == 1)
+            state.owner->Enqueue(dependent);
+    }
+}
+
+void JobSystem::Enqueue(const JobHandle &handle)
+{
+    handle->self = handle;
+    if (GetWorkerCount() == 1)
+    {
+        RunJob(handle.get(), 0, 0);
+        return;
+    }
+
+    Push(GetWorkerIndex(), {&JobSystem::RunJob, handle.get(), 0, 0});
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+    }
+    mWake.notify_one();
+}
+
+JobHandle JobSystem::Schedule(std::function<void()> job, const std::vector<JobHandle> &dependencies)
+{
+    auto handle = std::make_shared<JobState>();
+    handle->job = std::move(job);
+    handle->owner = this;
+    // one extra count so the job cannot start before every dependency is registered
+    handle->pendingDependencies = dependencies.size() + 1;
+    for (const auto &dependency : dependencies)
+    {
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (dependency->done)
+            handle->pendingDependencies.fetch_sub(1);
+        else
+            dependency->dependents.push_back(handle);
+    }
+    if (handle->pendingDependencies.fetch_sub(1) == 1)
+        Enqueue(handle);
+    return handle;
+}
+
+void JobSystem::Wait(const JobHandle &handle)
+{
+    while (!handle->done.load())
+    {
+        if (!RunOne())
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)> &body)
+{
+    if (count == 0)
+        return;
+    grain = std::max<size_t>(1, grain);
+
+    size_t chunkCount = (count + grain - 1) / grain;
+    size_t chunkSize = grain;
+    if (!deterministicPartitioning)
+    {
+        // a few chunks per thread leaves room for stealing
+        chunkCount = std::min(chunkCount, GetWorkerCount() * 4);
+        chunkSize = (count + chunkCount - 1) / chunkCount;
+        chunkCount = (count + chunkSize - 1) / chunkSize;
+    }
+
+    if (GetWorkerCount() == 1 || chunkCount == 1)
+    {
+        for (size_t begin = 0; begin < count; begin += chunkSize)
+            body(begin, std::min(begin + chunkSize, count));
+        return;
+    }
+
+    ParallelForContext context;
+    context.body = &body;
+    context.remaining = chunkCount;
+    size_t firstQueue = mNextQueue.fetch_add(1);
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        size_t begin = chunk * chunkSize;
+        Push((firstQueue + chunk) % mQueues.size(), {&RunParallelForChunk, &context, begin, std::min(begin + chunkSize, count)});
+    }
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+    }
+    mWake.notify_all();
+
+    while (context.remaining.load(std::memory_order_acquire) > 0)
+    {
+        if (!RunOne())
+            std::this_thread::yield();
+    }
+    if (context.error)
+        std::rethrow_exception(context.error);
+}
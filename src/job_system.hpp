@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+struct JobState
+{
+    JobSystem *owner = nullptr;
+    std::function<void()> job;
+    std::atomic<size_t> pendingDependencies{0};
+    std::atomic<bool> done{false};
+    std::mutex mutex;
+    std::vector<std::shared_ptr<JobState>> dependents;
+    std::shared_ptr<JobState> self; // keeps a queued job alive until it ran
+};
+
+using JobHandle = std::shared_ptr<JobState>;
+
+// Fork-join job system with one deque per thread: a thread pops its own deque from the back and
+// steals from the front of the others. Threads waiting on jobs (Wait, ParallelFor) execute queued
+// jobs instead of blocking, so jobs may schedule and wait on other jobs.
+class JobSystem
+{
+public:
+    // workerCount includes the calling thread; 1 runs every job on the caller, in order
+    explicit JobSystem(size_t workerCount = GetDefaultWorkerCount());
+    ~JobSystem();
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    static size_t GetDefaultWorkerCount();
+    // in [0, GetWorkerCount()); 0 on any thread that is not one of this system's workers
+    size_t GetWorkerIndex() const;
+
+    size_t GetWorkerCount() const { return mThreads.size() + 1; }
+    // joins and respawns the workers; no job may be in flight
+    void SetWorkerCount(size_t workerCount);
+
+    // runs the job once every dependency is done; the job must not throw
+    JobHandle Schedule(std::function<void()> job, const std::vector<JobHandle> &dependencies = {});
+    void Wait(const JobHandle &handle);
+
+    // body(begin, end) over [0, count), returns when every chunk is done; rethrows the first
+    // exception thrown by body. Chunks hold at least `grain` items.
+    void ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)> &body);
+
+    // chunks of exactly `grain` items whatever the worker count, so a body that keeps per-chunk
+    // results sees the same split on every machine
+    bool deterministicPartitioning = false;
+
+private:
+    struct Task
+    {
+        void (*run)(void *context, size_t begin, size_t end);
+        void *context;
+        size_t begin, end;
+    };
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void Start(size_t workerCount);
+    void Stop();
+    void WorkerLoop(size_t index);
+    void Push(size_t queue, const Task &task);
+    bool TryPop(size_t index, Task &task);
+    bool RunOne();
+    void Enqueue(const JobHandle &handle);
+    static void RunJob(void *context, size_t begin, size_t end);
+
+    std::vector<std::thread> mThreads;
+    std::vector<std::unique_ptr<Queue>> mQueues; // [0] belongs to outside threads
+    std::atomic<size_t> mQueuedCount{0};
+    std::atomic<size_t> mNextQueue{0};
+    std::mutex mSleepMutex;
+    std::condition_variable mWake;
+    bool mStopping = false;
+};
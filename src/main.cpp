@@ -17,6 +17,7 @@
 #include "physics_scene.hpp"
 #include "soft_body_loader.hpp"
 #include "joint_system.hpp"
+#include "job_system.hpp"
 
 const int WINDOW_WIDTH = 2000;
 const int WINDOW_HEIGHT = 2000;
@@ -42,6 +43,7 @@ SoftBody CreateSoftPolygon(int segments)
 
     AddCollisionPointsToLoop(softBody);
     AddCollisionShapeToLoop(softBody);
+    PartitionPointMasses(softBody);
 
     // ShapeMatchingConstraint shapeMatchingConstraint;
     // shapeMatchingConstraint.compliance = 0.1f;
@@ -230,13 +232,13 @@ int main()
     int solverSubsteps = 20;
     int solverIterations = 1;
 
-    std::random_device dev;
-    std::mt19937 rng(dev());
-
     PhysicsScene physicsScene;
     physicsScene.gravity = glm::vec2(0.0f, -9.8f);
-    physicsScene.softBodies.push_back(std::make_shared<SoftBody>(CreateSoftPolygon(rng() % 20)));
-    physicsScene.softBodies.push_back(std::make_shared<SoftBody>(CreateGround()));
+    physicsScene.random.Seed(std::random_device()());
+    physicsScene.jobSystem = std::make_shared<JobSystem>();
+    int workerCount = int(physicsScene.jobSystem->GetWorkerCount());
+    physicsScene.softBodies.push_back(std::make_shared<SoftBody>(CreateSoftPolygon(physicsScene.random.NextUInt() % 20)));
+    physicsScene.AddSoftBody(std::make_shared<SoftBody>(CreateGround()), BodyType::Static);
 
     TickSystem tickSystem(30.0f);
     tickSystem.SetTimeScale(10.f);
@@ -313,25 +315,25 @@ int main()
             window.setView(view);
 
             physicsScene.Clear();
-            physicsScene.softBodies.push_back(std::make_shared<SoftBody>(CreateSoftPolygon(rng() % 20)));
-            physicsScene.softBodies.push_back(std::make_shared<SoftBody>(CreateGround()));
+            physicsScene.softBodies.push_back(std::make_shared<SoftBody>(CreateSoftPolygon(physicsScene.random.NextUInt() % 20)));
+            physicsScene.AddSoftBody(std::make_shared<SoftBody>(CreateGround()), BodyType::Static);
         }
         if (ImGui::Button("Add car.json"))
         {
             car = LoadCarFromFile("car.json");
 
             AccelerationConstraint carAC;
-            carAC.indices = car.body.get()->collisionPoints;
+            carAC.indices = AppendDriveIndices(*car.body, car.body->topology->collisionPoints);
             car.body.get()->accelerationConstraints.push_back(carAC);
             carAccelerationConstraint = &car.body.get()->accelerationConstraints[0];
 
             AngularAccelerationConstraint carAAC;
-            carAAC.indices = car.body->collisionPoints;
+            carAAC.indices = AppendDriveIndices(*car.body, car.body->topology->collisionPoints);
             car.body->angularAccelerationConstraints.push_back(carAAC);
             carAngularAccelerationConstraint = &car.body.get()->angularAccelerationConstraints[0];
 
             AngularAccelerationConstraint wheelAAC;
-            wheelAAC.indices = car.wheels[0]->collisionPoints;
+            wheelAAC.indices = AppendDriveIndices(*car.wheels[0], car.wheels[0]->topology->collisionPoints);
             car.wheels[0]->angularAccelerationConstraints.push_back(wheelAAC);
             wheelAngularAccelerationConstraint = &car.wheels[0].get()->angularAccelerationConstraints[0];
 
@@ -357,7 +359,7 @@ int main()
             float tireTreadCompliance = .001f;
             float tirePressureCompliance = .001f;
             float tirePressure = 1.f;
-            int radialSegments = rng() % 20;
+            int radialSegments = physicsScene.random.NextUInt() % 20;
 
             physicsScene.softBodies.push_back(std::make_shared<SoftBody>(CreateWheel(
                 center,
@@ -375,8 +377,8 @@ int main()
         }
         if (ImGui::Button("Add body"))
         {
-            physicsScene.softBodies.push_back(std::make_shared<SoftBody>(CreateSoftPolygon(rng() % 20)));
-            physicsScene.softBodies.push_back(std::make_shared<SoftBody>(CreateSoftPolygon(rng() % 20)));
+            physicsScene.softBodies.push_back(std::make_shared<SoftBody>(CreateSoftPolygon(physicsScene.random.NextUInt() % 20)));
+            physicsScene.softBodies.push_back(std::make_shared<SoftBody>(CreateSoftPolygon(physicsScene.random.NextUInt() % 20)));
 
             auto softBody1 = physicsScene.softBodies[physicsScene.softBodies.size() - 2];
             auto softBody2 = physicsScene.softBodies[physicsScene.softBodies.size() - 1];
@@ -397,9 +399,9 @@ int main()
             motorJoint->softBody1 = softBody1;
             motorJoint->softBody2 = softBody2;
             motorJoint->anchorSoftBody = softBody1;
-            motorJoint->indices1 = softBody1->collisionPoints;
-            motorJoint->indices2 = softBody2->collisionPoints;
-            motorJoint->anchorIndices = softBody1->collisionPoints;
+            motorJoint->indices1 = softBody1->topology->collisionPoints;
+            motorJoint->indices2 = softBody2->topology->collisionPoints;
+            motorJoint->anchorIndices = softBody1->topology->collisionPoints;
             motorJoint->anchorStartPositions = softBody1->pointMasses.positions;
             motorJoint->targetRPM = 1.0f;
             motorJoint->torque = 10.0f;
@@ -415,6 +417,12 @@ int main()
         ImGui::SliderFloat("Gravity Y", &physicsScene.gravity.y, -20.f, 20.f);
         if (ImGui::Button("Gravity zedo"))
             physicsScene.gravity = {0.0f, 0.0f};
+        ImGui::Checkbox("Deterministic", &physicsScene.deterministic);
+        ImGui::Checkbox("Continuous collision", &physicsScene.continuousCollision);
+        ImGui::Checkbox("Speculative contacts", &physicsScene.speculativeContacts);
+        ImGui::Checkbox("Ignore jointed collisions", &physicsScene.ignoreJointedCollisions);
+        if (ImGui::SliderInt("Workers", &workerCount, 1, int(JobSystem::GetDefaultWorkerCount())))
+            physicsScene.jobSystem->SetWorkerCount(workerCount);
 
         if (carAngularAccelerationConstraint)
             carAngularAccelerationConstraint->position = ComputeMassCenter(car.body->pointMasses.positions, car.body->pointMasses.inverseMasses);
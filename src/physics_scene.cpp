@@ -1,7 +1,104 @@
 #include "physics_scene.hpp"
+#include "joint_system.hpp"
+
+#include <algorithm>
+#include <functional>
 
 void PhysicsScene::Clear() {
     softBodies.clear();
     distanceJoints.clear();
     motorJoints.clear();
+    ignoredPairs.clear();
+}
+
+
+void PhysicsScene::AddSoftBody(std::shared_ptr<SoftBody> softBody, BodyType type)
+{
+    if (type == BodyType::Static)
+        MakeStatic(*softBody);
+    else if (type == BodyType::Kinematic)
+        MakeKinematic(*softBody);
+    else
+        softBody->type = BodyType::Dynamic;
+
+    softBodies.push_back(softBody);
+}
+
+static std::pair<const SoftBody *, const SoftBody *> OrderedPair(const SoftBody *a, const SoftBody *b)
+{
+    return std::less<const SoftBody *>()(b, a) ? std::make_pair(b, a) : std::make_pair(a, b);
+}
+
+using WeakBodyPair = std::pair<std::weak_ptr<SoftBody>, std::weak_ptr<SoftBody>>;
+
+static WeakBodyPair OrderedWeakPair(const std::shared_ptr<SoftBody> &a, const std::shared_ptr<SoftBody> &b)
+{
+    return b.owner_before(a) ? WeakBodyPair(b, a) : WeakBodyPair(a, b);
+}
+
+static bool WeakPairLess(const WeakBodyPair &a, const WeakBodyPair &b)
+{
+    std::owner_less<std::weak_ptr<SoftBody>> less;
+    if (less(a.first, b.first))
+        return true;
+    if (less(b.first, a.first))
+        return false;
+    return less(a.second, b.second);
+}
+
+void PhysicsScene::IgnoreCollision(const std::shared_ptr<SoftBody> &a, const std::shared_ptr<SoftBody> &b, bool ignore)
+{
+    // pairs of destroyed bodies can never match again
+    auto expired = [](const WeakBodyPair &pair)
+    {
+        return pair.first.expired() || pair.second.expired();
+    };
+    ignoredPairs.erase(std::remove_if(ignoredPairs.begin(), ignoredPairs.end(), expired), ignoredPairs.end());
+
+    WeakBodyPair pair = OrderedWeakPair(a, b);
+    auto it = std::lower_bound(ignoredPairs.begin(), ignoredPairs.end(), pair, WeakPairLess);
+    bool found = it != ignoredPairs.end() && !WeakPairLess(pair, *it);
+    if (ignore && !found)
+        ignoredPairs.insert(it, pair);
+    else if (!ignore && found)
+        ignoredPairs.erase(it);
+}
+
+bool PhysicsScene::IsCollisionIgnored(const std::shared_ptr<SoftBody> &a, const std::shared_ptr<SoftBody> &b) const
+{
+    return std::binary_search(ignoredPairs.begin(), ignoredPairs.end(), OrderedWeakPair(a, b), WeakPairLess);
+}
+
+std::vector<std::pair<const SoftBody *, const SoftBody *>> PhysicsScene::CollectIgnoredPairs() const
+{
+    std::vector<std::pair<const SoftBody *, const SoftBody *>> pairs;
+    for (const auto &pair : ignoredPairs)
+    {
+        auto sb1 = pair.first.lock();
+        auto sb2 = pair.second.lock();
+        if (sb1 && sb2)
+            pairs.push_back(OrderedPair(sb1.get(), sb2.get()));
+    }
+
+    if (ignoreJointedCollisions)
+    {
+        auto addJoint = [&](const std::weak_ptr<SoftBody> &body1, const std::weak_ptr<SoftBody> &body2)
+        {
+            auto sb1 = body1.lock();
+            auto sb2 = body2.lock();
+            if (sb1 && sb2 && sb1 != sb2)
+                pairs.push_back(OrderedPair(sb1.get(), sb2.get()));
+        };
+        for (const auto &joint : distanceJoints)
+            addJoint(joint->softBody1, joint->softBody2);
+        for (const auto &joint : motorJoints)
+        {
+            addJoint(joint->softBody1, joint->softBody2);
+            addJoint(joint->softBody1, joint->anchorSoftBody);
+            addJoint(joint->softBody2, joint->anchorSoftBody);
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    return pairs;
 }
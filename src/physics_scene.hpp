@@ -2,9 +2,40 @@
 #include "soft_body.hpp"
 #include <vector>
 #include <memory>
+#include <cstdint>
+#include <utility>
 
 struct DistanceJoint;
 struct MotorJoint;
+class JobSystem;
+
+// PCG32; owned by the scene and stored in snapshots so seeded spawns replay identically
+struct SceneRandom
+{
+    uint64_t state = 0x853c49e6748fea9bULL;
+
+    explicit SceneRandom(uint64_t seed = 0) { Seed(seed); }
+
+    void Seed(uint64_t seed)
+    {
+        state = 0;
+        NextUInt();
+        state += seed;
+        NextUInt();
+    }
+
+    uint32_t NextUInt()
+    {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t xorshifted = uint32_t(((old >> 18u) ^ old) >> 27u);
+        uint32_t rot = uint32_t(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+
+    // [0, 1)
+    float NextFloat() { return float(NextUInt() >> 8) * (1.0f / 16777216.0f); }
+};
 
 class PhysicsScene
 {
@@ -12,10 +43,38 @@ class PhysicsScene
     PhysicsScene() {};
     
     void Clear();
+    void AddSoftBody(std::shared_ptr<SoftBody> softBody, BodyType type = BodyType::Dynamic);
+
+    // the pair never collides, whatever the bodies' categories and masks
+    void IgnoreCollision(const std::shared_ptr<SoftBody> &a, const std::shared_ptr<SoftBody> &b, bool ignore = true);
+    bool IsCollisionIgnored(const std::shared_ptr<SoftBody> &a, const std::shared_ptr<SoftBody> &b) const;
+    // live ignoredPairs plus, with ignoreJointedCollisions, every pair of bodies sharing a joint; sorted by
+    // address, valid for one Simulate
+    std::vector<std::pair<const SoftBody *, const SoftBody *>> CollectIgnoredPairs() const;
     
     glm::vec2 gravity = glm::vec2(0.0f, 0.0f);
+
+    // Deterministic mode: the same scene construction and the same inputs give a bit-identical
+    // ComputeStateHash on the same binary, whatever the thread count. Contacts are solved in a
+    // canonical order (body order, then point index) instead of detection order. Builds must not
+    // use -ffast-math or FMA contraction for the guarantee to hold across machines.
+    bool deterministic = false;
+    // swept point-edge tests over prevPositions -> positions, so fast points cannot skip through thin
+    // bodies between substeps
+    bool continuousCollision = false;
+    // detect contacts once per tick instead of every substep; points within velocity * dt of a body
+    // get speculative contacts that only push while penetrating. Overrides continuousCollision.
+    bool speculativeContacts = false;
+    // bodies connected by a distance or motor joint do not collide with each other
+    bool ignoreJointedCollisions = false;
+    SceneRandom random;
+    std::shared_ptr<JobSystem> jobSystem; // null runs Simulate on the calling thread
     std::vector<std::shared_ptr<SoftBody>> softBodies;
     
     std::vector<std::shared_ptr<DistanceJoint>> distanceJoints;
     std::vector<std::shared_ptr<MotorJoint>> motorJoints;
+
+    // sorted by owner, lower owner first; see IgnoreCollision. Keyed by owner rather than address, so a
+    // body allocated where a destroyed one lived does not inherit its pairs
+    std::vector<std::pair<std::weak_ptr<SoftBody>, std::weak_ptr<SoftBody>>> ignoredPairs;
 };
@@ -55,7 +55,7 @@ void Renderer::DrawSoftBody(const SoftBody &softBody)
     }
 
     // Draw distance constraints
-    for (const auto &c : softBody.distanceConstraints)
+    for (const auto &c : softBody.topology->distanceConstraints)
     {
         const auto &a = softBody.pointMasses[c.a];
         const auto &b = softBody.pointMasses[c.b];
@@ -142,17 +142,17 @@ void Renderer::DrawSoftBodies(const std::vector<SoftBody> &softBodies)
 void Renderer::DrawSoftBody(const SoftBody &softBoby)
 {
     auto &positions = softBoby.pointMasses.positions;
-    auto &shape = softBoby.collisionShape;
-    int shape_n = softBoby.collisionShape.size();
+    auto &shape = softBoby.topology->collisionShape;
+    int shape_n = softBoby.topology->collisionShape.size();
 
-    for (const DistanceConstraint &c : softBoby.distanceConstraints)
+    for (const DistanceConstraint &c : softBoby.topology->distanceConstraints)
     {
         glm::vec2 positionA = softBoby.pointMasses.positions[c.i1];
         glm::vec2 positionB = softBoby.pointMasses.positions[c.i2];
         DrawLine({positionA.x, positionA.y}, {positionB.x, positionB.y}, sf::Color::Cyan);
     }
 
-    for (const auto c : softBoby.collisionPoints)
+    for (const auto c : softBoby.topology->collisionPoints)
     {
         DrawCircle(positions[c], 1.5, sf::Color::White);
     }
@@ -0,0 +1,412 @@
+#include "replay.hpp"
+#include "simulation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+const uint32_t REPLAY_MAGIC = 0x4c505253; // "SRPL"
+const uint32_t REPLAY_VERSION = 2;
+
+struct ReplayFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t mode;
+    uint32_t keyframeInterval;
+    float positionQuantum;
+    uint32_t padding;
+};
+
+struct ReplayBlockHeader
+{
+    uint32_t firstTick;
+    uint32_t tickCount;
+    uint32_t rawSize;
+    uint32_t compressedSize;
+};
+
+// tick record header in Inputs mode, followed by CaptureInputs bytes
+struct ReplayStepParams
+{
+    float dt;
+    int32_t substeps;
+    int32_t iterations;
+};
+
+template <typename T>
+static void PutValue(std::vector<char> &out, const T &value)
+{
+    const char *bytes = reinterpret_cast<const char *>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+static void PutVarint(std::vector<char> &out, int32_t value)
+{
+    uint32_t zigzag = (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+    while (zigzag >= 0x80)
+    {
+        out.push_back(char(zigzag | 0x80));
+        zigzag >>= 7;
+    }
+    out.push_back(char(zigzag));
+}
+
+static const char *Take(const std::vector<char> &in, size_t &cursor, size_t size)
+{
+    if (size > in.size() - cursor)
+        throw std::runtime_error("Corrupt replay block");
+    const char *bytes = in.data() + cursor;
+    cursor += size;
+    return bytes;
+}
+
+template <typename T>
+static T TakeValue(const std::vector<char> &in, size_t &cursor)
+{
+    T value;
+    std::memcpy(&value, Take(in, cursor, sizeof(T)), sizeof(T));
+    return value;
+}
+
+static int32_t TakeVarint(const std::vector<char> &in, size_t &cursor)
+{
+    uint32_t zigzag = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        uint8_t byte = uint8_t(*Take(in, cursor, 1));
+        zigzag |= uint32_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return int32_t(zigzag >> 1) ^ -int32_t(zigzag & 1);
+    }
+    throw std::runtime_error("Corrupt replay block");
+}
+
+// Block compression: token < 0x80 is a literal run of token + 1 bytes, otherwise a run of
+// (token & 0x7f) + 1 zero bytes. Unchanged inputs XOR to zero and well predicted positions
+// encode as zero varints, so most of a block collapses into zero runs.
+static void CompressBlock(const std::vector<char> &in, std::vector<char> &out)
+{
+    out.clear();
+    size_t i = 0;
+    while (i < in.size())
+    {
+        size_t zeros = 0;
+        while (i + zeros < in.size() && in[i + zeros] == 0 && zeros < 128)
+            ++zeros;
+        if (zeros >= 2)
+        {
+            out.push_back(char(0x80 | (zeros - 1)));
+            i += zeros;
+            continue;
+        }
+
+        size_t begin = i;
+        while (i < in.size() && i - begin < 128)
+        {
+            if (in[i] == 0 && i + 1 < in.size() && in[i + 1] == 0)
+                break;
+            ++i;
+        }
+        out.push_back(char(i - begin - 1));
+        out.insert(out.end(), in.begin() + begin, in.begin() + i);
+    }
+}
+
+static void DecompressBlock(const char *in, size_t size, size_t rawSize, std::vector<char> &out)
+{
+    out.clear();
+    out.reserve(rawSize);
+    size_t i = 0;
+    while (i < size)
+    {
+        uint8_t token = uint8_t(in[i++]);
+        size_t count = (token & 0x7f) + 1;
+        if (token & 0x80)
+            out.insert(out.end(), count, 0);
+        else
+        {
+            if (count > size - i)
+                throw std::runtime_error("Corrupt replay block");
+            out.insert(out.end(), in + i, in + i + count);
+            i += count;
+        }
+    }
+    if (out.size() != rawSize)
+        throw std::runtime_error("Corrupt replay block");
+}
+
+static size_t CountPoints(const PhysicsScene &physicsScene)
+{
+    size_t count = 0;
+    for (const auto &sbPtr : physicsScene.softBodies)
+        count += sbPtr->pointMasses.positions.size();
+    return count;
+}
+
+static void GatherPositions(const PhysicsScene &physicsScene, std::vector<glm::vec2> &out)
+{
+    out.clear();
+    for (const auto &sbPtr : physicsScene.softBodies)
+        out.insert(out.end(), sbPtr->pointMasses.positions.begin(), sbPtr->pointMasses.positions.end());
+}
+
+ReplayRecorder::ReplayRecorder(const std::string &filename, const ReplaySettings &settings)
+    : mFile(filename, std::ios::binary | std::ios::trunc), mSettings(settings)
+{
+    if (!mFile.is_open())
+        throw std::runtime_error("Failed to open file: " + filename);
+    if (mSettings.keyframeInterval == 0)
+        mSettings.keyframeInterval = 1;
+
+    ReplayFileHeader header = {};
+    header.magic = REPLAY_MAGIC;
+    header.version = REPLAY_VERSION;
+    header.mode = uint32_t(mSettings.mode);
+    header.keyframeInterval = mSettings.keyframeInterval;
+    header.positionQuantum = mSettings.positionQuantum;
+    mFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+ReplayRecorder::~ReplayRecorder()
+{
+    Flush();
+}
+
+void ReplayRecorder::RecordTick(const PhysicsScene &physicsScene, float dt, int substeps, int iterations)
+{
+    if (mBlockTickCount == mSettings.keyframeInterval)
+        Flush();
+
+    bool keyframe = mBlockTickCount == 0;
+    if (keyframe)
+    {
+        mBlockFirstTick = mTick;
+        mBlock.clear();
+        CaptureSnapshot(physicsScene, mSnapshot);
+        PutValue(mBlock, uint32_t(mSnapshot.size));
+        mBlock.insert(mBlock.end(), mSnapshot.buffer.begin(), mSnapshot.buffer.begin() + mSnapshot.size);
+    }
+
+    if (mSettings.mode == ReplayMode::Inputs)
+    {
+        CaptureInputs(physicsScene, mSnapshot);
+        size_t recordSize = sizeof(ReplayStepParams) + mSnapshot.size;
+        if (keyframe)
+        {
+            PutValue(mBlock, uint32_t(recordSize));
+            mPrevRecord.assign(recordSize, 0);
+        }
+        else if (recordSize != mPrevRecord.size())
+            throw std::runtime_error("Scene layout changed while recording a replay");
+
+        ReplayStepParams params{dt, substeps, iterations};
+        char paramBytes[sizeof(ReplayStepParams)];
+        std::memcpy(paramBytes, &params, sizeof(params));
+        for (size_t i = 0; i < recordSize; ++i)
+        {
+            char byte = i < sizeof(params) ? paramBytes[i] : mSnapshot.buffer[i - sizeof(params)];
+            mBlock.push_back(char(byte ^ mPrevRecord[i]));
+            mPrevRecord[i] = byte;
+        }
+    }
+    else if (keyframe)
+    {
+        GatherPositions(physicsScene, mReconstructed);
+        mReconstructedPrev = mReconstructed;
+    }
+    else
+    {
+        if (CountPoints(physicsScene) != mReconstructed.size())
+            throw std::runtime_error("Scene layout changed while recording a replay");
+
+        // second order prediction from what the player will have reconstructed, so errors never accumulate
+        float q = mSettings.positionQuantum;
+        size_t k = 0;
+        for (const auto &sbPtr : physicsScene.softBodies)
+        {
+            for (const glm::vec2 &p : sbPtr->pointMasses.positions)
+            {
+                glm::vec2 predicted = 2.0f * mReconstructed[k] - mReconstructedPrev[k];
+                glm::vec2 residual = glm::clamp(glm::round((p - predicted) / q), glm::vec2(-1e9f), glm::vec2(1e9f));
+                int32_t rx = int32_t(residual.x);
+                int32_t ry = int32_t(residual.y);
+                PutVarint(mBlock, rx);
+                PutVarint(mBlock, ry);
+                mReconstructedPrev[k] = mReconstructed[k];
+                mReconstructed[k] = predicted + glm::vec2(float(rx), float(ry)) * q;
+                ++k;
+            }
+        }
+    }
+
+    ++mBlockTickCount;
+    ++mTick;
+}
+
+void ReplayRecorder::Flush()
+{
+    if (mBlockTickCount == 0)
+        return;
+
+    std::vector<char> compressed;
+    CompressBlock(mBlock, compressed);
+
+    ReplayBlockHeader header;
+    header.firstTick = mBlockFirstTick;
+    header.tickCount = mBlockTickCount;
+    header.rawSize = uint32_t(mBlock.size());
+    header.compressedSize = uint32_t(compressed.size());
+    mFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    mFile.write(compressed.data(), std::streamsize(compressed.size()));
+    mFile.flush();
+
+    mBlockTickCount = 0;
+}
+
+ReplayPlayer::ReplayPlayer(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open file: " + filename);
+    mData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    ReplayFileHeader header;
+    if (mData.size() < sizeof(header))
+        throw std::runtime_error("Corrupt replay: " + filename);
+    std::memcpy(&header, mData.data(), sizeof(header));
+    if (header.magic != REPLAY_MAGIC || header.version != REPLAY_VERSION)
+        throw std::runtime_error("Unsupported replay: " + filename);
+    mSettings.mode = ReplayMode(header.mode);
+    mSettings.keyframeInterval = header.keyframeInterval;
+    mSettings.positionQuantum = header.positionQuantum;
+
+    // a truncated last block (recorder killed mid-write) is dropped
+    size_t offset = sizeof(header);
+    while (mData.size() - offset >= sizeof(ReplayBlockHeader))
+    {
+        ReplayBlockHeader blockHeader;
+        std::memcpy(&blockHeader, mData.data() + offset, sizeof(blockHeader));
+        offset += sizeof(blockHeader);
+        if (blockHeader.compressedSize > mData.size() - offset || blockHeader.firstTick != mTickCount)
+            break;
+
+        mBlocks.push_back({blockHeader.firstTick, blockHeader.tickCount, blockHeader.rawSize, offset, blockHeader.compressedSize});
+        mTickCount += blockHeader.tickCount;
+        offset += blockHeader.compressedSize;
+    }
+}
+
+void ReplayPlayer::LoadBlock(PhysicsScene &physicsScene, size_t blockIndex)
+{
+    const Block &block = mBlocks[blockIndex];
+    DecompressBlock(mData.data() + block.offset, block.compressedSize, block.rawSize, mBlock);
+    mBlockIndex = blockIndex;
+    mTick = block.firstTick;
+    mCursor = 0;
+
+    uint32_t keyframeSize = TakeValue<uint32_t>(mBlock, mCursor);
+    const char *keyframe = Take(mBlock, mCursor, keyframeSize);
+    mSnapshot.buffer.assign(keyframe, keyframe + keyframeSize);
+    mSnapshot.size = keyframeSize;
+    RestoreSnapshot(physicsScene, mSnapshot);
+
+    if (mSettings.mode == ReplayMode::Inputs)
+        mPrevRecord.assign(TakeValue<uint32_t>(mBlock, mCursor), 0);
+    else
+    {
+        GatherPositions(physicsScene, mReconstructed);
+        mReconstructedPrev = mReconstructed;
+    }
+
+    ReadTick(physicsScene);
+}
+
+void ReplayPlayer::ReadTick(PhysicsScene &physicsScene)
+{
+    if (mSettings.mode == ReplayMode::Inputs)
+    {
+        if (mPrevRecord.size() < sizeof(ReplayStepParams))
+            throw std::runtime_error("Corrupt replay block");
+        const char *bytes = Take(mBlock, mCursor, mPrevRecord.size());
+        for (size_t i = 0; i < mPrevRecord.size(); ++i)
+            mPrevRecord[i] ^= bytes[i];
+
+        ReplayStepParams params;
+        std::memcpy(&params, mPrevRecord.data(), sizeof(params));
+        mDt = params.dt;
+        mSubsteps = params.substeps;
+        mIterations = params.iterations;
+
+        mSnapshot.buffer.assign(mPrevRecord.begin() + sizeof(params), mPrevRecord.end());
+        mSnapshot.size = mSnapshot.buffer.size();
+        RestoreInputs(physicsScene, mSnapshot);
+        return;
+    }
+
+    // the keyframe tick carries no positions
+    if (mTick == mBlocks[mBlockIndex].firstTick)
+        return;
+    if (CountPoints(physicsScene) != mReconstructed.size())
+        throw std::runtime_error("Replay does not match the scene layout");
+
+    float q = mSettings.positionQuantum;
+    size_t k = 0;
+    for (auto &sbPtr : physicsScene.softBodies)
+    {
+        PointMasses &pm = sbPtr->pointMasses;
+        for (size_t i = 0; i < pm.positions.size(); ++i, ++k)
+        {
+            glm::vec2 predicted = 2.0f * mReconstructed[k] - mReconstructedPrev[k];
+            int32_t rx = TakeVarint(mBlock, mCursor);
+            int32_t ry = TakeVarint(mBlock, mCursor);
+            mReconstructedPrev[k] = mReconstructed[k];
+            mReconstructed[k] = predicted + glm::vec2(float(rx), float(ry)) * q;
+
+            pm.prevPositions[i] = pm.positions[i];
+            pm.positions[i] = mReconstructed[k];
+        }
+    }
+}
+
+void ReplayPlayer::Seek(PhysicsScene &physicsScene, uint32_t tick)
+{
+    if (mBlocks.empty())
+        throw std::runtime_error("Replay is empty");
+    tick = std::min(tick, mTickCount - 1);
+
+    auto next = std::upper_bound(mBlocks.begin(), mBlocks.end(), tick,
+                                 [](uint32_t t, const Block &block)
+                                 { return t < block.firstTick; });
+    LoadBlock(physicsScene, size_t(next - mBlocks.begin()) - 1);
+
+    while (mTick < tick)
+        Step(physicsScene);
+}
+
+bool ReplayPlayer::Step(PhysicsScene &physicsScene)
+{
+    if (mBlocks.empty() || mTick + 1 >= mTickCount)
+        return false;
+    if (mBlock.empty())
+    {
+        LoadBlock(physicsScene, 0);
+        return true;
+    }
+
+    if (mSettings.mode == ReplayMode::Inputs)
+        Simulate(physicsScene, mDt, mSubsteps, mIterations);
+
+    const Block &block = mBlocks[mBlockIndex];
+    if (mTick + 1 == block.firstTick + block.tickCount)
+    {
+        // the next keyframe also resyncs a replay recorded on a machine with different rounding
+        LoadBlock(physicsScene, mBlockIndex + 1);
+        return true;
+    }
+
+    ++mTick;
+    ReadTick(physicsScene);
+    return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "physics_scene.hpp"
+#include "scene_snapshot.hpp"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+enum class ReplayMode : uint32_t
+{
+    Inputs,    // per-tick inputs, playback re-simulates; needs a deterministic Simulate
+    Positions, // per-tick quantized particle positions, playback never simulates
+};
+
+struct ReplaySettings
+{
+    ReplayMode mode = ReplayMode::Inputs;
+    uint32_t keyframeInterval = 900;     // ticks per block; every block starts with a full SceneSnapshot
+    float positionQuantum = 1.0f / 64.0f; // Positions mode, max error is half of it
+};
+
+// Appends blocks of ticks to a replay file. Call RecordTick once per tick, after the inputs are
+// set and before Simulate. Collision toggles and per-body filters are recorded with the inputs, so
+// they may change between ticks. The scene layout (bodies, joints, drives, ignored body pairs) must
+// not change while recording and must match at playback.
+class ReplayRecorder
+{
+public:
+    ReplayRecorder(const std::string &filename, const ReplaySettings &settings = ReplaySettings());
+    ~ReplayRecorder();
+
+    void RecordTick(const PhysicsScene &physicsScene, float dt, int substeps, int iterations);
+    void Flush();
+
+    uint32_t GetTickCount() const { return mTick; }
+
+private:
+    std::ofstream mFile;
+    ReplaySettings mSettings;
+    uint32_t mTick = 0;
+    uint32_t mBlockFirstTick = 0;
+    uint32_t mBlockTickCount = 0;
+    std::vector<char> mBlock;
+    SceneSnapshot mSnapshot;
+    std::vector<char> mPrevRecord;
+    std::vector<glm::vec2> mReconstructed, mReconstructedPrev;
+};
+
+// Plays a replay into a scene with the same layout as the recorded one.
+class ReplayPlayer
+{
+public:
+    explicit ReplayPlayer(const std::string &filename);
+
+    uint32_t GetTickCount() const { return mTickCount; }
+    uint32_t GetTick() const { return mTick; }
+
+    // scene state at the start of `tick`, from the nearest keyframe at or before it
+    void Seek(PhysicsScene &physicsScene, uint32_t tick);
+    // false once the last recorded tick has been played
+    bool Step(PhysicsScene &physicsScene);
+
+private:
+    struct Block
+    {
+        uint32_t firstTick;
+        uint32_t tickCount;
+        uint32_t rawSize;
+        size_t offset;
+        size_t compressedSize;
+    };
+
+    void LoadBlock(PhysicsScene &physicsScene, size_t blockIndex);
+    void ReadTick(PhysicsScene &physicsScene);
+
+    ReplaySettings mSettings;
+    std::vector<char> mData;
+    std::vector<Block> mBlocks;
+    uint32_t mTickCount = 0;
+
+    size_t mBlockIndex = 0;
+    uint32_t mTick = 0;
+    std::vector<char> mBlock;
+    size_t mCursor = 0;
+    SceneSnapshot mSnapshot;
+    std::vector<char> mPrevRecord;
+    float mDt = 0.0f;
+    int32_t mSubsteps = 1, mIterations = 1;
+    std::vector<glm::vec2> mReconstructed, mReconstructedPrev;
+};
@@ -0,0 +1,329 @@
+#include "scene_query.hpp"
+#include "job_system.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// [t0, t1] of origin + direction * t inside the box, clipped to the incoming range
+static bool RayBoxRange(const glm::vec2 &origin, const glm::vec2 &direction, const glm::vec2 &min, const glm::vec2 &max, float &t0, float &t1)
+{
+    for (int k = 0; k < 2; ++k)
+    {
+        if (std::abs(direction[k]) < 1e-12f)
+        {
+            if (origin[k] < min[k] || origin[k] > max[k])
+                return false;
+            continue;
+        }
+        float ta = (min[k] - origin[k]) / direction[k];
+        float tb = (max[k] - origin[k]) / direction[k];
+        if (ta > tb)
+            std::swap(ta, tb);
+        t0 = std::max(t0, ta);
+        t1 = std::min(t1, tb);
+        if (t0 > t1)
+            return false;
+    }
+    return true;
+}
+
+static bool RayEdge(const glm::vec2 &origin, const glm::vec2 &direction, const glm::vec2 &a, const glm::vec2 &b, float &t)
+{
+    glm::vec2 edge = b - a;
+    float denom = Cross2D(direction, edge);
+    if (std::abs(denom) < 1e-12f)
+        return false;
+    t = Cross2D(a - origin, edge) / denom;
+    float s = Cross2D(a - origin, direction) / denom;
+    return t >= 0.0f && s >= 0.0f && s <= 1.0f;
+}
+
+static glm::vec2 ClosestPointOnEdge(const glm::vec2 &point, const glm::vec2 &a, const glm::vec2 &b)
+{
+    glm::vec2 edge = b - a;
+    float lengthSq = glm::dot(edge, edge);
+    if (lengthSq < 1e-12f)
+        return a;
+    return a + edge * glm::clamp(glm::dot(point - a, edge) / lengthSq, 0.0f, 1.0f);
+}
+
+static bool PointInShape(const glm::vec2 &point, const std::vector<glm::vec2> &positions, const std::vector<uint32_t> &shape)
+{
+    int windingNumber = 0;
+    size_t n = shape.size();
+    for (size_t i = 0; i < n; ++i)
+    {
+        const glm::vec2 &v1 = positions[shape[i]];
+        const glm::vec2 &v2 = positions[shape[(i + 1) % n]];
+        if (v1.y <= point.y)
+        {
+            if (v2.y > point.y && Cross2D(v2 - v1, point - v1) > 0)
+                ++windingNumber;
+        }
+        else
+        {
+            if (v2.y <= point.y && Cross2D(v2 - v1, point - v1) < 0)
+                --windingNumber;
+        }
+    }
+    return windingNumber != 0;
+}
+
+SceneQuery::SceneQuery(const PhysicsScene &physicsScene)
+    : mScene(physicsScene)
+{
+    Update();
+}
+
+void SceneQuery::Update()
+{
+    mBounds.resize(mScene.softBodies.size());
+    for (size_t b = 0; b < mBounds.size(); ++b)
+        mBounds[b] = ComputeBodyBounds(*mScene.softBodies[b]);
+}
+
+bool SceneQuery::Accepts(size_t body, const SceneQueryFilter &filter) const
+{
+    const SoftBody &softBody = *mScene.softBodies[body];
+    return (softBody.collisionCategory & filter.categoryMask) != 0 && &softBody != filter.ignoreBody && softBody.topology->collisionShape.size() >= 2;
+}
+
+// nearest hit on one body within maxT, or every hit when allHits is given; direction is unit length
+bool SceneQuery::RaycastBody(size_t body, const glm::vec2 &origin, const glm::vec2 &direction, float maxT, SceneRayHit &hit, std::vector<SceneRayHit> *allHits) const
+{
+    const SoftBody &softBody = *mScene.softBodies[body];
+    const auto &positions = softBody.pointMasses.positions;
+    const auto &shape = softBody.topology->collisionShape;
+    size_t n = shape.size();
+
+    bool found = false;
+    // a grid cell only keeps hits that lie in it, so an edge spanning several cells is reported once
+    auto testEdge = [&](uint32_t e, long cell, const StaticEdgeGrid *grid)
+    {
+        const glm::vec2 &a = positions[shape[e]];
+        const glm::vec2 &b = positions[shape[(e + 1) % n]];
+        float t;
+        if (!RayEdge(origin, direction, a, b, t) || t > maxT)
+            return;
+        if (!allHits && found && (t > hit.distance || (t == hit.distance && e > hit.edgeIndex)))
+            return;
+        glm::vec2 point = origin + direction * t;
+        if (grid)
+        {
+            int u = grid->axis;
+            long cellCount = long(grid->cellStarts.size()) - 1;
+            long hitCell = std::min<long>(long(std::max((point[u] - grid->min[u]) / grid->cellSize, 0.0f)), cellCount - 1);
+            if (hitCell != cell)
+                return;
+        }
+
+        SceneRayHit edgeHit;
+        edgeHit.bodyIndex = uint32_t(body);
+        edgeHit.edgeIndex = e;
+        edgeHit.point = point;
+        edgeHit.normal = glm::normalize(Perp2D(b - a));
+        if (glm::dot(edgeHit.normal, direction) > 0.0f)
+            edgeHit.normal = -edgeHit.normal;
+        edgeHit.distance = t;
+        if (allHits)
+            allHits->push_back(edgeHit);
+        else
+            hit = edgeHit;
+        found = true;
+    };
+
+    const StaticEdgeGrid *grid = softBody.type == BodyType::Static ? softBody.staticEdgeGrid.get() : nullptr;
+    if (!grid)
+    {
+        for (size_t e = 0; e < n; ++e)
+            testEdge(uint32_t(e), 0, nullptr);
+        return found;
+    }
+
+    // walk the cells in ray order; hits in a cell are all nearer than any hit in a later one
+    float t0 = 0.0f, t1 = maxT;
+    if (!RayBoxRange(origin, direction, grid->min, grid->max, t0, t1))
+        return false;
+    int u = grid->axis;
+    long cellCount = long(grid->cellStarts.size()) - 1;
+    auto cellOf = [&](float t)
+    {
+        float x = origin[u] + direction[u] * t;
+        return std::min<long>(long(std::max((x - grid->min[u]) / grid->cellSize, 0.0f)), cellCount - 1);
+    };
+    long first = cellOf(t0);
+    long last = cellOf(t1);
+    long step = first <= last ? 1 : -1;
+    for (long c = first;; c += step)
+    {
+        for (uint32_t k = grid->cellStarts[c]; k < grid->cellStarts[c + 1]; ++k)
+            testEdge(grid->cellEdges[k], c, grid);
+        if ((found && !allHits) || c == last)
+            break;
+    }
+    return found;
+}
+
+std::optional<SceneRayHit> SceneQuery::RaycastClosest(const SceneRay &ray, const SceneQueryFilter &filter) const
+{
+    float length = glm::length(ray.direction);
+    if (length <= 0.0f)
+        return std::nullopt;
+    glm::vec2 direction = ray.direction / length;
+
+    std::vector<std::pair<float, uint32_t>> candidates;
+    for (size_t b = 0; b < mBounds.size(); ++b)
+    {
+        float t0 = 0.0f, t1 = ray.maxDistance;
+        if (Accepts(b, filter) && RayBoxRange(ray.origin, direction, mBounds[b].min, mBounds[b].max, t0, t1))
+            candidates.emplace_back(t0, uint32_t(b));
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    std::optional<SceneRayHit> closest;
+    for (const auto &[entry, b] : candidates)
+    {
+        float maxT = closest ? closest->distance : ray.maxDistance;
+        if (entry > maxT)
+            break;
+        SceneRayHit hit;
+        if (RaycastBody(b, ray.origin, direction, maxT, hit, nullptr) && (!closest || hit.distance < closest->distance))
+            closest = hit;
+    }
+    return closest;
+}
+
+std::vector<SceneRayHit> SceneQuery::RaycastAll(const SceneRay &ray, const SceneQueryFilter &filter) const
+{
+    std::vector<SceneRayHit> hits;
+    float length = glm::length(ray.direction);
+    if (length <= 0.0f)
+        return hits;
+    glm::vec2 direction = ray.direction / length;
+
+    for (size_t b = 0; b < mBounds.size(); ++b)
+    {
+        float t0 = 0.0f, t1 = ray.maxDistance;
+        if (!Accepts(b, filter) || !RayBoxRange(ray.origin, direction, mBounds[b].min, mBounds[b].max, t0, t1))
+            continue;
+        SceneRayHit unused;
+        RaycastBody(b, ray.origin, direction, ray.maxDistance, unused, &hits);
+    }
+    std::sort(hits.begin(), hits.end(),
+              [](const SceneRayHit &a, const SceneRayHit &b)
+              {
+                  if (a.distance != b.distance)
+                      return a.distance < b.distance;
+                  if (a.bodyIndex != b.bodyIndex)
+                      return a.bodyIndex < b.bodyIndex;
+                  return a.edgeIndex < b.edgeIndex;
+              });
+    return hits;
+}
+
+void SceneQuery::RaycastBatch(const std::vector<SceneRay> &rays, std::vector<std::optional<SceneRayHit>> &hits, const SceneQueryFilter &filter) const
+{
+    hits.resize(rays.size());
+    auto range = [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+            hits[i] = RaycastClosest(rays[i], filter);
+    };
+    if (mScene.jobSystem)
+        mScene.jobSystem->ParallelFor(rays.size(), 16, range);
+    else
+        range(0, rays.size());
+}
+
+std::vector<uint32_t> SceneQuery::OverlapBox(const glm::vec2 &min, const glm::vec2 &max, const SceneQueryFilter &filter) const
+{
+    std::vector<uint32_t> bodies;
+    BodyBounds box = {min, max};
+    for (size_t b = 0; b < mBounds.size(); ++b)
+    {
+        if (!Accepts(b, filter) || !BoundsOverlap(mBounds[b], box))
+            continue;
+
+        // an edge crossing the box, or the box inside the shape
+        const SoftBody &softBody = *mScene.softBodies[b];
+        const auto &positions = softBody.pointMasses.positions;
+        const auto &shape = softBody.topology->collisionShape;
+        size_t n = shape.size();
+        bool overlaps = false;
+        for (size_t e = 0; e < n && !overlaps; ++e)
+        {
+            const glm::vec2 &p = positions[shape[e]];
+            float t0 = 0.0f, t1 = 1.0f;
+            overlaps = RayBoxRange(p, positions[shape[(e + 1) % n]] - p, min, max, t0, t1);
+        }
+        if (!overlaps)
+        {
+            const StaticEdgeGrid *grid = softBody.type == BodyType::Static ? softBody.staticEdgeGrid.get() : nullptr;
+            overlaps = grid ? PointInStaticGrid(min, positions, shape, *grid) : PointInShape(min, positions, shape);
+        }
+        if (overlaps)
+            bodies.push_back(uint32_t(b));
+    }
+    return bodies;
+}
+
+std::vector<uint32_t> SceneQuery::ContainingBodies(const glm::vec2 &point, const SceneQueryFilter &filter) const
+{
+    std::vector<uint32_t> bodies;
+    BodyBounds pointBounds = {point, point};
+    for (size_t b = 0; b < mBounds.size(); ++b)
+    {
+        if (!Accepts(b, filter) || !BoundsOverlap(mBounds[b], pointBounds))
+            continue;
+        const SoftBody &softBody = *mScene.softBodies[b];
+        const auto &positions = softBody.pointMasses.positions;
+        const auto &shape = softBody.topology->collisionShape;
+        const StaticEdgeGrid *grid = softBody.type == BodyType::Static ? softBody.staticEdgeGrid.get() : nullptr;
+        if (grid ? PointInStaticGrid(point, positions, shape, *grid) : PointInShape(point, positions, shape))
+            bodies.push_back(uint32_t(b));
+    }
+    return bodies;
+}
+
+std::optional<SceneClosestPoint> SceneQuery::ClosestPoint(const glm::vec2 &point, float maxDistance, const SceneQueryFilter &filter) const
+{
+    // bodies by distance to their bounds, which no point of the shape can beat
+    std::vector<std::pair<float, uint32_t>> candidates;
+    for (size_t b = 0; b < mBounds.size(); ++b)
+    {
+        glm::vec2 outside = glm::max(glm::max(mBounds[b].min - point, point - mBounds[b].max), glm::vec2(0.0f));
+        float distance = glm::length(outside);
+        if (Accepts(b, filter) && distance <= maxDistance)
+            candidates.emplace_back(distance, uint32_t(b));
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    std::optional<SceneClosestPoint> closest;
+    for (const auto &[boundsDistance, b] : candidates)
+    {
+        if (closest && boundsDistance >= closest->distance)
+            break;
+        const SoftBody &softBody = *mScene.softBodies[b];
+        const auto &positions = softBody.pointMasses.positions;
+        const auto &shape = softBody.topology->collisionShape;
+        size_t n = shape.size();
+
+        auto testEdge = [&](uint32_t e)
+        {
+            glm::vec2 onEdge = ClosestPointOnEdge(point, positions[shape[e]], positions[shape[(e + 1) % n]]);
+            float distance = glm::length(onEdge - point);
+            if (distance > maxDistance || (closest && distance >= closest->distance))
+                return;
+            closest = SceneClosestPoint{b, e, onEdge, distance};
+        };
+        if (softBody.type == BodyType::Static && softBody.staticEdgeGrid)
+            testEdge(NearestEdgeInStaticGrid(point, positions, shape, *softBody.staticEdgeGrid));
+        else
+        {
+            for (size_t e = 0; e < n; ++e)
+                testEdge(uint32_t(e));
+        }
+    }
+    return closest;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "physics_scene.hpp"
+#include "collision_system.hpp"
+#include "glm/glm.hpp"
+#include <limits>
+#include <optional>
+#include <vector>
+
+// bodies a query sees: collisionCategory must share a bit with categoryMask
+struct SceneQueryFilter
+{
+    uint32_t categoryMask = 0xffffffffu;
+    const SoftBody *ignoreBody = nullptr; // e.g. the car casting the rays
+};
+
+struct SceneRay
+{
+    glm::vec2 origin;
+    glm::vec2 direction; // need not be normalized
+    float maxDistance = std::numeric_limits<float>::max();
+};
+
+struct SceneRayHit
+{
+    uint32_t bodyIndex; // in PhysicsScene::softBodies
+    uint32_t edgeIndex; // edge of the body's collisionShape
+    glm::vec2 point;
+    glm::vec2 normal; // unit edge normal facing the ray origin
+    float distance;
+};
+
+struct SceneClosestPoint
+{
+    uint32_t bodyIndex;
+    uint32_t edgeIndex;
+    glm::vec2 point; // on the body's collisionShape
+    float distance;
+};
+
+// Read-only spatial queries against the collision shapes of a scene's bodies. Body bounds are the
+// broadphase and are taken when the query is built, so call Update after the bodies moved (once per
+// tick, after Simulate). Static bodies go through their StaticEdgeGrid once Simulate has built it.
+class SceneQuery
+{
+public:
+    explicit SceneQuery(const PhysicsScene &physicsScene);
+    void Update();
+
+    // nearest hit; bodies are visited in order of their bounds along the ray and the walk stops at
+    // the first one that starts beyond the best hit
+    std::optional<SceneRayHit> RaycastClosest(const SceneRay &ray, const SceneQueryFilter &filter = {}) const;
+    // every edge crossing within ray.maxDistance, nearest first
+    std::vector<SceneRayHit> RaycastAll(const SceneRay &ray, const SceneQueryFilter &filter = {}) const;
+    // RaycastClosest for every ray, spread over the scene's job system when it has one
+    void RaycastBatch(const std::vector<SceneRay> &rays, std::vector<std::optional<SceneRayHit>> &hits, const SceneQueryFilter &filter = {}) const;
+
+    // bodies whose collision shape overlaps the box, in body order
+    std::vector<uint32_t> OverlapBox(const glm::vec2 &min, const glm::vec2 &max, const SceneQueryFilter &filter = {}) const;
+    // bodies whose collision shape contains the point, in body order
+    std::vector<uint32_t> ContainingBodies(const glm::vec2 &point, const SceneQueryFilter &filter = {}) const;
+    // nearest point on any collision shape within maxDistance
+    std::optional<SceneClosestPoint> ClosestPoint(const glm::vec2 &point, float maxDistance = std::numeric_limits<float>::max(), const SceneQueryFilter &filter = {}) const;
+
+private:
+    bool Accepts(size_t body, const SceneQueryFilter &filter) const;
+    bool RaycastBody(size_t body, const glm::vec2 &origin, const glm::vec2 &direction, float maxT, SceneRayHit &hit, std::vector<SceneRayHit> *allHits) const;
+
+    const PhysicsScene &mScene;
+    std::vector<BodyBounds> mBounds;
+};
@@ -0,0 +1,230 @@
+#include "scene_snapshot.hpp"
+#include "joint_system.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+struct SnapshotSizer
+{
+    size_t size = 0;
+
+    template <typename T>
+    void Value(const T &)
+    {
+        size += sizeof(T);
+    }
+
+    template <typename T>
+    void Array(const std::vector<T> &values, bool = false)
+    {
+        size += sizeof(uint32_t) + values.size() * sizeof(T);
+    }
+};
+
+struct SnapshotWriter
+{
+    char *cursor;
+
+    template <typename T>
+    void Value(const T &value)
+    {
+        std::memcpy(cursor, &value, sizeof(T));
+        cursor += sizeof(T);
+    }
+
+    template <typename T>
+    void Array(const std::vector<T> &values, bool = false)
+    {
+        uint32_t count = uint32_t(values.size());
+        Value(count);
+        std::memcpy(cursor, values.data(), count * sizeof(T));
+        cursor += count * sizeof(T);
+    }
+};
+
+struct SnapshotReader
+{
+    const char *cursor;
+    const char *end;
+
+    void Require(size_t bytes)
+    {
+        if (size_t(end - cursor) < bytes)
+            throw std::runtime_error("Snapshot does not match the scene layout");
+    }
+
+    template <typename T>
+    void Value(T &value)
+    {
+        Require(sizeof(T));
+        std::memcpy(&value, cursor, sizeof(T));
+        cursor += sizeof(T);
+    }
+
+    // resizable arrays hold per-step scratch (lambdas) whose size follows the topology lazily
+    template <typename T>
+    void Array(std::vector<T> &values, bool resizable = false)
+    {
+        uint32_t count;
+        Value(count);
+        if (count != values.size())
+        {
+            if (!resizable)
+                throw std::runtime_error("Snapshot does not match the scene layout");
+            values.resize(count);
+        }
+        Require(count * sizeof(T));
+        std::memcpy(values.data(), cursor, count * sizeof(T));
+        cursor += count * sizeof(T);
+    }
+};
+
+template <typename Scene, typename Visitor>
+static void VisitSceneLayout(Scene &physicsScene, Visitor &visitor)
+{
+    uint32_t bodyCount = uint32_t(physicsScene.softBodies.size());
+    uint32_t distanceJointCount = uint32_t(physicsScene.distanceJoints.size());
+    uint32_t motorJointCount = uint32_t(physicsScene.motorJoints.size());
+    visitor.Value(bodyCount);
+    visitor.Value(distanceJointCount);
+    visitor.Value(motorJointCount);
+    if (bodyCount != physicsScene.softBodies.size() ||
+        distanceJointCount != physicsScene.distanceJoints.size() ||
+        motorJointCount != physicsScene.motorJoints.size())
+        throw std::runtime_error("Snapshot does not match the scene layout");
+}
+
+// what the game sets from outside between ticks
+template <typename Scene, typename Visitor>
+static void VisitSceneInputs(Scene &physicsScene, Visitor &visitor)
+{
+    visitor.Value(physicsScene.gravity);
+    visitor.Value(physicsScene.random);
+
+    // runtime toggles that change what Simulate produces
+    visitor.Value(physicsScene.deterministic);
+    visitor.Value(physicsScene.continuousCollision);
+    visitor.Value(physicsScene.speculativeContacts);
+    visitor.Value(physicsScene.ignoreJointedCollisions);
+
+    for (auto &sbPtr : physicsScene.softBodies)
+    {
+        auto &sb = *sbPtr;
+        visitor.Array(sb.accelerationConstraints);
+        visitor.Array(sb.forceConstraints);
+        visitor.Array(sb.VelocityConstraints);
+        visitor.Array(sb.angularAccelerationConstraints);
+        visitor.Array(sb.angularForceConstraints);
+        visitor.Array(sb.angularVelocityConstraints);
+        visitor.Value(sb.kinematicTarget);
+        visitor.Value(sb.collisionCategory);
+        visitor.Value(sb.collisionMask);
+        visitor.Value(sb.selfCollision);
+    }
+
+    for (auto &j : physicsScene.motorJoints)
+    {
+        visitor.Value(j->targetRPM);
+        visitor.Value(j->torque);
+    }
+}
+
+// single field list for sizing, capture and restore; Scene is PhysicsScene or const PhysicsScene
+template <typename Scene, typename Visitor>
+static void VisitSceneState(Scene &physicsScene, Visitor &visitor)
+{
+    VisitSceneLayout(physicsScene, visitor);
+    VisitSceneInputs(physicsScene, visitor);
+
+    for (auto &sbPtr : physicsScene.softBodies)
+    {
+        auto &sb = *sbPtr;
+        visitor.Array(sb.pointMasses.positions);
+        visitor.Array(sb.pointMasses.prevPositions);
+        visitor.Array(sb.pointMasses.velocities);
+
+        visitor.Array(sb.lambdas.distance, true);
+        visitor.Array(sb.lambdas.volume, true);
+        visitor.Array(sb.lambdas.angle, true);
+        visitor.Array(sb.lambdas.shapeMatching, true);
+        visitor.Array(sb.lambdas.pin, true);
+
+        visitor.Value(sb.kinematicTransform);
+    }
+
+    for (auto &j : physicsScene.distanceJoints)
+        visitor.Value(j->lambda);
+    for (auto &j : physicsScene.motorJoints)
+        visitor.Value(j->lambda);
+}
+
+template <typename Scene, typename Visitor>
+static void VisitSceneLayoutAndInputs(Scene &physicsScene, Visitor &visitor)
+{
+    VisitSceneLayout(physicsScene, visitor);
+    VisitSceneInputs(physicsScene, visitor);
+}
+
+size_t ComputeSnapshotSize(const PhysicsScene &physicsScene)
+{
+    SnapshotSizer sizer;
+    VisitSceneState(physicsScene, sizer);
+    return sizer.size;
+}
+
+void CaptureSnapshot(const PhysicsScene &physicsScene, SceneSnapshot &snapshot)
+{
+    snapshot.size = ComputeSnapshotSize(physicsScene);
+    if (snapshot.buffer.size() < snapshot.size)
+        snapshot.buffer.resize(snapshot.size);
+
+    SnapshotWriter writer{snapshot.buffer.data()};
+    VisitSceneState(physicsScene, writer);
+}
+
+void RestoreSnapshot(PhysicsScene &physicsScene, const SceneSnapshot &snapshot)
+{
+    SnapshotReader reader{snapshot.buffer.data(), snapshot.buffer.data() + snapshot.size};
+    VisitSceneState(physicsScene, reader);
+    if (reader.cursor != reader.end)
+        throw std::runtime_error("Snapshot does not match the scene layout");
+}
+
+void CaptureInputs(const PhysicsScene &physicsScene, SceneSnapshot &snapshot)
+{
+    SnapshotSizer sizer;
+    VisitSceneLayoutAndInputs(physicsScene, sizer);
+    snapshot.size = sizer.size;
+    if (snapshot.buffer.size() < snapshot.size)
+        snapshot.buffer.resize(snapshot.size);
+
+    SnapshotWriter writer{snapshot.buffer.data()};
+    VisitSceneLayoutAndInputs(physicsScene, writer);
+}
+
+void RestoreInputs(PhysicsScene &physicsScene, const SceneSnapshot &snapshot)
+{
+    SnapshotReader reader{snapshot.buffer.data(), snapshot.buffer.data() + snapshot.size};
+    VisitSceneLayoutAndInputs(physicsScene, reader);
+    if (reader.cursor != reader.end)
+        throw std::runtime_error("Snapshot does not match the scene layout");
+}
+
+// FNV-1a over the snapshot bytes
+uint64_t HashSnapshot(const SceneSnapshot &snapshot)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < snapshot.size; ++i)
+    {
+        hash ^= uint8_t(snapshot.buffer[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint64_t ComputeStateHash(const PhysicsScene &physicsScene)
+{
+    SceneSnapshot snapshot;
+    CaptureSnapshot(physicsScene, snapshot);
+    return HashSnapshot(snapshot);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "physics_scene.hpp"
+#include <vector>
+
+// Everything in a PhysicsScene that changes while simulating: particle state, solver lambdas,
+// drive values, collision settings, kinematic transforms and joint state. Topology is not stored,
+// so a snapshot restores only into the scene it was captured from (same bodies, joints and drives).
+struct SceneSnapshot
+{
+    std::vector<char> buffer; // reused between captures, grows only when the scene does
+    size_t size = 0;
+};
+
+size_t ComputeSnapshotSize(const PhysicsScene &physicsScene);
+void CaptureSnapshot(const PhysicsScene &physicsScene, SceneSnapshot &snapshot);
+void RestoreSnapshot(PhysicsScene &physicsScene, const SceneSnapshot &snapshot);
+
+// only the externally driven part (gravity, collision settings and filters, drives, kinematic targets,
+// motor targets)
+void CaptureInputs(const PhysicsScene &physicsScene, SceneSnapshot &snapshot);
+void RestoreInputs(PhysicsScene &physicsScene, const SceneSnapshot &snapshot);
+
+// bit-exact state hash for lockstep and replay validation, see PhysicsScene::deterministic
+uint64_t HashSnapshot(const SceneSnapshot &snapshot);
+uint64_t ComputeStateHash(const PhysicsScene &physicsScene);
@@ -2,6 +2,9 @@
 #include <cmath>
 #include <algorithm>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <tuple>
 
 SoftBody CreateWheel(
     const glm::vec2 &center,
@@ -23,6 +26,19 @@ SoftBody CreateWheel(
     radialSegments = std::clamp(radialSegments, 3, 30);
     tireRatio = std::clamp(tireRatio, 0.1f, 0.7f);
 
+    // wheels with the same parameters share one template built at the origin
+    using WheelKey = std::tuple<float, float, float, float, float, float, float, float, float, float, int>;
+    static std::map<WheelKey, std::weak_ptr<const SoftBodyTemplate>> templates;
+    static std::mutex templatesMutex;
+    WheelKey key(wheelRadius, diskMass, tireMass, tireRatio,
+                 diskHubCompliance, diskRimCompliance, tireBodyCompliance, tireTreadCompliance,
+                 tirePressureCompliance, tirePressure, radialSegments);
+    std::lock_guard<std::mutex> lock(templatesMutex);
+    PruneExpiredTemplates(templates);
+    if (auto shared = templates[key].lock())
+        return InstantiateSoftBody(shared, center);
+
+    const glm::vec2 origin(0.0f);
     SoftBody wheel;
     PointMasses &pm = wheel.pointMasses;
 
@@ -35,8 +51,8 @@ SoftBody CreateWheel(
     float rotate_angle = float(M_PI) / radialSegments;
 
     // центральная точка
-    pm.positions.push_back(center);
-    pm.prevPositions.push_back(center);
+    pm.positions.push_back(origin);
+    pm.prevPositions.push_back(origin);
     pm.velocities.push_back({0.0f, 0.0f});
     pm.inverseMasses.push_back(1.0f / diskPointMass);
 
@@ -50,7 +66,7 @@ SoftBody CreateWheel(
     // }
 
     // tire
-    for (auto p : CreatePoigonPositions(radialSegments, wheelRadius, center)) // , -rotate_angle
+    for (auto p : CreatePoigonPositions(radialSegments, wheelRadius, origin)) // , -rotate_angle
     {
         pm.positions.push_back(p);
         pm.prevPositions.push_back(p);
@@ -59,8 +75,10 @@ SoftBody CreateWheel(
     }
 
     VolumeConstraint vc_tire;
+    std::vector<uint32_t> tireIndices;
 
-    std::vector<DistanceConstraint> &dc = wheel.distanceConstraints;
+    SoftBodyTemplate &topology = MutableTopology(wheel);
+    std::vector<DistanceConstraint> &dc = topology.distanceConstraints;
 
     int diskStart = 1;
     int tireStart = 1 + radialSegments;
@@ -82,21 +100,25 @@ SoftBody CreateWheel(
         dc.push_back(CreateDistanceConstraint(pm.positions, diskStart + i, diskStart + next, tireTreadCompliance));
         dc.push_back(CreateDistanceConstraint(pm.positions, diskStart + i, diskStart + ((i + radialSegments / 3) % radialSegments), tireBodyCompliance));
 
-        // vc_tire.indices.push_back(tireStart + i);
+        // tireIndices.push_back(tireStart + i);
         // wheel.collisionPoints.push_back(tireStart + i);
         // wheel.collisionShape.push_back(tireStart + i);
 
-        vc_tire.indices.push_back(diskStart + i);
-        wheel.collisionPoints.push_back(diskStart + i);
-        wheel.collisionShape.push_back(diskStart + i);
+        tireIndices.push_back(diskStart + i);
+        topology.collisionPoints.push_back(diskStart + i);
+        topology.collisionShape.push_back(diskStart + i);
     }
 
+    vc_tire.indices = AppendConstraintIndices(wheel, tireIndices);
     vc_tire.compliance = tirePressureCompliance;
-    vc_tire.restVolume = tirePressure * ComputePolygonArea(pm.positions, vc_tire.indices);
+    vc_tire.restVolume = tirePressure * ComputePolygonArea(pm.positions, tireIndices);
 
-    wheel.volumeConstraints.push_back(vc_tire);
+    topology.volumeConstraints.push_back(vc_tire);
+    PartitionPointMasses(wheel);
 
-    return wheel;
+    auto shared = MakeSoftBodyTemplate(wheel);
+    templates[key] = shared;
+    return InstantiateSoftBody(shared, center);
 }
 
 std::vector<glm::vec2> CreatePoigonPositions(int segments, float radius, glm::vec2 origin, float rotate_angle)
@@ -120,25 +142,27 @@ void AddDistanceConstraintsToLoop(SoftBody &softBody, float compliance)
 {
     int pointCount = softBody.pointMasses.positions.size();
     for (int i = 0; i < pointCount; ++i)
-        softBody.distanceConstraints.push_back(CreateDistanceConstraint(softBody.pointMasses.positions, i, (i + 1) % pointCount, compliance));
+        MutableTopology(softBody).distanceConstraints.push_back(CreateDistanceConstraint(softBody.pointMasses.positions, i, (i + 1) % pointCount, compliance));
 }
 void AddVolumeConstraintToLoop(SoftBody &softBody, float compliance)
 {
     VolumeConstraint vc;
+    std::vector<uint32_t> indices;
     for (int i = 0; i < softBody.pointMasses.positions.size(); ++i)
-        vc.indices.push_back(i);
+        indices.push_back(i);
 
-    vc.restVolume = ComputePolygonArea(softBody.pointMasses.positions, vc.indices);
+    vc.indices = AppendConstraintIndices(softBody, indices);
+    vc.restVolume = ComputePolygonArea(softBody.pointMasses.positions, indices);
     vc.compliance = compliance;
-    softBody.volumeConstraints.push_back(vc);
+    MutableTopology(softBody).volumeConstraints.push_back(vc);
 }
 void AddCollisionPointsToLoop(SoftBody &softBody)
 {
     for (int i = 0; i < softBody.pointMasses.positions.size(); ++i)
-        softBody.collisionPoints.push_back(i);
+        MutableTopology(softBody).collisionPoints.push_back(i);
 }
 void AddCollisionShapeToLoop(SoftBody &softBody)
 {
     for (int i = 0; i < softBody.pointMasses.positions.size(); ++i)
-        softBody.collisionShape.push_back(i);
+        MutableTopology(softBody).collisionShape.push_back(i);
 }
\ No newline at end of file
@@ -4,86 +4,218 @@
 #include "collision_system.hpp"
 #include "integrator.hpp"
 #include "renderer.hpp"
+#include "job_system.hpp"
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
 
+// body(i) for every i in [0, count), spread over the scene's job system when it has one
+template <typename Body>
+static void ForEach(PhysicsScene &physicsScene, size_t count, const Body &body)
+{
+    if (!physicsScene.jobSystem)
+    {
+        for (size_t i = 0; i < count; ++i)
+            body(i);
+        return;
+    }
+    auto range = [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+            body(i);
+    };
+    physicsScene.jobSystem->ParallelFor(count, 1, range);
+}
+
 void Simulate(PhysicsScene &physicsScene, float dt, int substeps, int iterations)
 {
     std::vector<std::shared_ptr<SoftBody>> &softBodies = physicsScene.softBodies;
     float substep_dt = dt / substeps;
 
-    for (int step = 0; step < substeps; ++step)
+    // narrow phase scratch, reused across substeps; every worker appends to its own buffer
+    size_t workerCount = physicsScene.jobSystem ? physicsScene.jobSystem->GetWorkerCount() : 1;
+    std::vector<std::vector<SoftSoftCollisionConstraint>> workerConstraints(workerCount);
+    std::vector<BodyBounds> bounds(softBodies.size());
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    struct PairRange
     {
-        for (auto &sbPtr : softBodies)
-        {
-            Integrate(sbPtr->pointMasses, substep_dt, physicsScene.gravity);
+        uint32_t worker, begin, end;
+    };
+    std::vector<PairRange> pairRanges;
+    std::vector<SoftSoftCollisionConstraint> collisionConstraints;
+    ContactBatches contactBatches;
+    NearestEdgeCache edgeCache; // contacts of the previous substep of this tick
+    std::vector<std::pair<const SoftBody *, const SoftBody *>> ignoredPairs = physicsScene.CollectIgnoredPairs();
 
-            ResetConstrainsLambdas(*sbPtr);
+    // speculative contacts are detected on the first substep and kept for the tick
+    bool detectOnce = physicsScene.speculativeContacts;
+    float speculativeTime = detectOnce ? dt : 0.0f;
+    bool continuous = physicsScene.continuousCollision && !detectOnce;
 
-            for (int i = 0; i < iterations; ++i)
-            {
-                SolveAccelerationConstraints(sbPtr->pointMasses, sbPtr->accelerationConstraints, substep_dt / iterations);
-                SolveForceConstraints(sbPtr->pointMasses, sbPtr->forceConstraints, substep_dt / iterations);
-                SolveVelocityConstraints(sbPtr->pointMasses, sbPtr->VelocityConstraints, substep_dt / iterations);
-                SolveAngularAccelerationConstraints(sbPtr->pointMasses, sbPtr->angularAccelerationConstraints, substep_dt / iterations);
-                SolveAngularForceConstraints(sbPtr->pointMasses, sbPtr->angularForceConstraints, substep_dt / iterations);
-                SolveAngularVelocityConstraints(sbPtr->pointMasses, sbPtr->angularVelocityConstraints, substep_dt / iterations);
-
-                SolveDistanceConstraints(sbPtr->pointMasses, sbPtr->distanceConstraints, substep_dt);
-                SolveVolumeConstraints(sbPtr->pointMasses, sbPtr->volumeConstraints, substep_dt);
-                SolveAngleConstraints(sbPtr->pointMasses, sbPtr->angleConstraints, substep_dt);
-                SolvePinConstraints(sbPtr->pointMasses, sbPtr->pinConstraints, substep_dt);
-                SolveShapeMatchingConstraints(sbPtr->pointMasses, sbPtr->shapeMatchingConstraints, substep_dt);
-            }
+    for (int step = 0; step < substeps; ++step)
+    {
+        // bodies only touch their own particles until the joints
+        auto integrateBody = [&](size_t b)
+        {
+            SoftBody &softBody = *softBodies[b];
+            if (softBody.type == BodyType::Kinematic)
+                IntegrateKinematic(softBody, float(step + 1) / substeps, substep_dt);
+            if (softBody.type != BodyType::Dynamic)
+                return;
 
-            // Renderer::DrawSoftBody(softBody);
-        }
+            AccumulateDriveAccelerations(softBody, substep_dt, physicsScene.gravity);
+            Integrate(softBody.pointMasses, softBody.driveAccelerations, substep_dt, physicsScene.gravity);
 
+            ResetConstrainsLambdas(softBody);
+        };
+        ForEach(physicsScene, softBodies.size(), integrateBody);
         ResetJointsLambdas(physicsScene);
-        for (int i = 0; i < iterations; ++i)
+
+        if (detectOnce && step > 0)
         {
-            SolveDistanceJoints(physicsScene.distanceJoints, substep_dt);
-            SolveMotorJoints(physicsScene.motorJoints, substep_dt);
+            GatherContactBatches(collisionConstraints, substep_dt, contactBatches);
         }
-
-        // detection collisions
-        std::vector<SoftSoftCollisionConstraint> collisionConstraints;
-        for (size_t i = 0; i < softBodies.size(); ++i)
+        else
         {
-            for (size_t j = 0; j < softBodies.size(); ++j)
+            // contacts are detected on the predicted positions and kept for the substep, or for the tick
+            // when speculative
+            // broadphase: bounds overlap, and every self-colliding body paired with itself; static grids
+            // are built lazily, so build them before going wide
+            auto computeBounds = [&](size_t b)
+            {
+                bounds[b] = ComputeBodyBounds(*softBodies[b], continuous, speculativeTime);
+            };
+            ForEach(physicsScene, softBodies.size(), computeBounds);
+
+            pairs.clear();
+            for (size_t i = 0; i < softBodies.size(); ++i)
             {
+                if (softBodies[i]->type == BodyType::Static && !softBodies[i]->staticEdgeGrid)
+                    softBodies[i]->staticEdgeGrid = BuildStaticEdgeGrid(*softBodies[i]);
+                if (softBodies[i]->type == BodyType::Dynamic && softBodies[i]->selfCollision)
+                    pairs.emplace_back(uint32_t(i), uint32_t(i));
+                for (size_t j = i + 1; j < softBodies.size(); ++j)
+                {
+                    const SoftBody *a = softBodies[i].get();
+                    const SoftBody *b = softBodies[j].get();
+                    if (a->type != BodyType::Dynamic && b->type != BodyType::Dynamic)
+                        continue;
+                    if (!CollisionFiltersMatch(*a, *b))
+                        continue;
+                    if (!BoundsOverlap(bounds[i], bounds[j]))
+                        continue;
+                    auto key = std::less<const SoftBody *>()(b, a) ? std::make_pair(b, a) : std::make_pair(a, b);
+                    if (std::binary_search(ignoredPairs.begin(), ignoredPairs.end(), key))
+                        continue;
+                    pairs.emplace_back(uint32_t(i), uint32_t(j));
+                }
+            }
+
+            // narrow phase
+            for (auto &constraints : workerConstraints)
+                constraints.clear();
+            pairRanges.resize(pairs.size());
+            auto detectPair = [&](size_t p)
+            {
+                uint32_t i = pairs[p].first, j = pairs[p].second;
+                uint32_t worker = uint32_t(physicsScene.jobSystem ? physicsScene.jobSystem->GetWorkerIndex() : 0);
+                std::vector<SoftSoftCollisionConstraint> &out = workerConstraints[worker];
+                size_t begin = out.size();
                 if (i == j)
-                    continue;
+                {
+                    DetectSelfCollisions(
+                        *softBodies[i],
+                        /*compliance*/ 0.0001f,
+                        /*frictionStatic*/ 1.0f,
+                        /*frictionKinetic*/ 0.3f,
+                        out,
+                        speculativeTime);
+                    for (size_t c = begin; c < out.size(); ++c)
+                        out[c].bodyIndexA = out[c].bodyIndexB = i;
+                    pairRanges[p] = {worker, uint32_t(begin), uint32_t(out.size())};
+                    return;
+                }
                 DetectSoftSoftCollisions(
                     *softBodies[i],
                     *softBodies[j],
                     /*compliance*/ 0.0001f,
                     /*frictionStatic*/ 1.0f,
                     /*frictionKinetic*/ 0.3f,
-                    collisionConstraints);
+                    out,
+                    continuous,
+                    speculativeTime,
+                    &edgeCache);
+                size_t middle = out.size();
                 DetectSoftSoftCollisions(
                     *softBodies[j],
                     *softBodies[i],
                     /*compliance*/ 0.0001f,
                     /*frictionStatic*/ 1.0f,
                     /*frictionKinetic*/ 0.3f,
-                    collisionConstraints);
+                    out,
+                    continuous,
+                    speculativeTime,
+                    &edgeCache);
+                for (size_t c = begin; c < out.size(); ++c)
+                {
+                    out[c].bodyIndexA = c < middle ? i : j;
+                    out[c].bodyIndexB = c < middle ? j : i;
+                }
+                pairRanges[p] = {worker, uint32_t(begin), uint32_t(out.size())};
+            };
+            ForEach(physicsScene, pairs.size(), detectPair);
+
+            // merge in pair order, so the contact list does not depend on the worker count
+            collisionConstraints.clear();
+            for (const PairRange &range : pairRanges)
+            {
+                const auto &constraints = workerConstraints[range.worker];
+                collisionConstraints.insert(collisionConstraints.end(), constraints.begin() + range.begin, constraints.begin() + range.end);
             }
+            if (physicsScene.deterministic)
+                std::sort(collisionConstraints.begin(), collisionConstraints.end(), ContactOrderLess);
+            BuildContactBatches(softBodies, collisionConstraints, substep_dt, contactBatches);
+            BuildNearestEdgeCache(collisionConstraints, edgeCache);
         }
 
-        // solve collisions
-        for (auto &cc : collisionConstraints)
+        // one Gauss-Seidel sweep over internal constraints, joints and contacts per iteration
+        auto solveBody = [&](size_t b)
+        {
+            SoftBody &softBody = *softBodies[b];
+            if (softBody.type != BodyType::Dynamic)
+                return;
+
+            const SoftBodyTemplate &topology = *softBody.topology;
+            ConstraintLambdas &lambdas = softBody.lambdas;
+            SolveDistanceConstraints(softBody.pointMasses, topology.distanceConstraints, lambdas.distance, substep_dt);
+            SolveVolumeConstraints(softBody.pointMasses, topology.volumeConstraints, topology.constraintIndices, lambdas.volume, substep_dt);
+            SolveAngleConstraints(softBody.pointMasses, topology.angleConstraints, topology.angleConstraintColors, lambdas.angle, substep_dt);
+            SolvePinConstraints(softBody.pointMasses, topology.pinConstraints, lambdas.pin, substep_dt);
+            SolveShapeMatchingConstraints(softBody.pointMasses, topology.shapeMatchingConstraints, topology.constraintIndices, topology.constraintRestOffsets, lambdas.shapeMatching, substep_dt);
+        };
+        for (int i = 0; i < iterations; ++i)
         {
-            // Renderer::DrawSoftSoftPointEdgeCollision(cc);
+            ForEach(physicsScene, softBodies.size(), solveBody);
+
+            SolveDistanceJoints(physicsScene.distanceJoints, substep_dt);
+            SolveMotorJoints(physicsScene.motorJoints, substep_dt);
 
-            for (int i = 0; i < iterations; ++i)
-                SolveSoftSoftCollisionConstraint(cc, substep_dt);
+            SolveContactBatches(contactBatches);
         }
 
         // update velocity
-        for (auto &sbPtr : softBodies)
+        auto updateVelocities = [&](size_t b)
         {
-            UpdateVelocities(sbPtr->pointMasses, substep_dt);
-        }
+            if (softBodies[b]->type == BodyType::Dynamic)
+                UpdateVelocities(softBodies[b]->pointMasses, substep_dt);
+        };
+        ForEach(physicsScene, softBodies.size(), updateVelocities);
+    }
+
+    for (auto &sbPtr : softBodies)
+    {
+        if (sbPtr->type == BodyType::Kinematic)
+            sbPtr->kinematicTransform = sbPtr->kinematicTarget;
     }
 }
@@ -12,7 +12,6 @@ DistanceConstraint CreateDistanceConstraint(const std::vector<glm::vec2> &positi
     constraint.i2 = i2;
     constraint.restDistance = glm::distance(positions[i1], positions[i2]);
     constraint.compliance = compliance;
-    constraint.lambda = 0.0f;
     return constraint;
 }
 DistanceConstraint CreateDistanceConstraint(const std::vector<glm::vec2> &positions, uint32_t i1, uint32_t i2, float compliance, float restDistance)
@@ -27,35 +26,405 @@ AngleConstraint CreateAngleConstraint(const std::vector<glm::vec2> &positions, u
     constraint.i1 = i1;
     constraint.i2 = i2;
     constraint.i3 = i3;
-    constraint.restAngle = CalculateAngle(positions[i1], positions[i2], positions[i3]);
+    constraint.restRotation = glm::vec2(1.0f, 0.0f);
+
+    glm::vec2 a = positions[i1] - positions[i2];
+    glm::vec2 b = positions[i3] - positions[i2];
+    glm::vec2 rotation(glm::dot(a, b), Cross2D(a, b));
+    float len = glm::length(rotation);
+    if (len > 1e-6f)
+        constraint.restRotation = rotation / len;
+
     constraint.compliance = compliance;
-    constraint.lambda = 0.0f;
     return constraint;
 }
 
 AngleConstraint CreateAngleConstraint(const std::vector<glm::vec2> &positions, uint32_t i1, uint32_t i2, uint32_t i3, float compliance, float restAngle)
 {
     AngleConstraint constraint = CreateAngleConstraint(positions, i1, i2, i3, compliance);
-    constraint.restAngle = restAngle;
+    constraint.restRotation = glm::vec2(std::cos(restAngle), std::sin(restAngle));
     return constraint;
 }
 
-void ResetConstrainsLambdas(SoftBody &softBody)
+// copy-on-write: only a template this body built and shares with nobody is edited in place; spawned
+// instances (whose template may be interned) and copies of a body under construction clone it first
+SoftBodyTemplate &MutableTopology(SoftBody &softBody)
+{
+    // topology and buildingTopology are the two owners of a template only this body holds
+    bool owned = softBody.buildingTopology && softBody.topology == softBody.buildingTopology && softBody.topology.use_count() == 2;
+    if (!owned)
+    {
+        softBody.buildingTopology = std::make_shared<SoftBodyTemplate>(softBody.topology ? *softBody.topology : SoftBodyTemplate());
+        softBody.topology = softBody.buildingTopology;
+    }
+    return *softBody.buildingTopology;
+}
+
+std::shared_ptr<const SoftBodyTemplate> MakeSoftBodyTemplate(const SoftBody &softBody)
+{
+    auto topology = std::make_shared<SoftBodyTemplate>(*softBody.topology);
+    topology->restState = softBody.pointMasses;
+    topology->restState.prevPositions = topology->restState.positions;
+    std::fill(topology->restState.velocities.begin(), topology->restState.velocities.end(), glm::vec2(0.0f));
+    return topology;
+}
+
+SoftBody InstantiateSoftBody(const std::shared_ptr<const SoftBodyTemplate> &topology, const glm::vec2 &offset)
+{
+    SoftBody softBody;
+    softBody.topology = topology;
+    softBody.pointMasses = topology->restState;
+    for (auto &p : softBody.pointMasses.positions)
+        p += offset;
+    softBody.pointMasses.prevPositions = softBody.pointMasses.positions;
+    return softBody;
+}
+
+static IndexRange AppendIndices(std::vector<uint32_t> &pool, const std::vector<uint32_t> &indices)
+{
+    IndexRange range;
+    range.begin = pool.size();
+    range.count = indices.size();
+    pool.insert(pool.end(), indices.begin(), indices.end());
+    return range;
+}
+
+IndexRange AppendConstraintIndices(SoftBody &softBody, const std::vector<uint32_t> &indices)
+{
+    return AppendIndices(MutableTopology(softBody).constraintIndices, indices);
+}
+
+IndexRange AppendDriveIndices(SoftBody &softBody, const std::vector<uint32_t> &indices)
+{
+    return AppendIndices(softBody.driveIndices, indices);
+}
+
+// startPositions are parallel to indices; rest frame (centroid, q_i, Aqq^-1) is cached once here
+ShapeMatchingConstraint CreateShapeMatchingConstraint(SoftBody &softBody, const std::vector<uint32_t> &indices, const std::vector<glm::vec2> &startPositions, float compliance, float linearity)
+{
+    ShapeMatchingConstraint constraint;
+    constraint.compliance = compliance;
+    constraint.linearity = linearity;
+
+    if (startPositions.empty() || startPositions.size() != indices.size())
+        return constraint;
+
+    constraint.indices = AppendConstraintIndices(softBody, indices);
+    constraint.restCenter = ComputeGeometryCenter(startPositions);
+
+    auto &restOffsets = MutableTopology(softBody).constraintRestOffsets;
+    constraint.restOffsetsBegin = restOffsets.size();
+
+    glm::mat2 Aqq(0.0f);
+    for (const auto &p : startPositions)
+    {
+        glm::vec2 q = p - constraint.restCenter;
+        restOffsets.push_back(q);
+        Aqq += glm::outerProduct(q, q);
+    }
+
+    if (std::abs(glm::determinant(Aqq)) > 1e-6f)
+        constraint.restAqqInverse = glm::inverse(Aqq);
+
+    return constraint;
+}
+
+// greedy coloring: constraints of one color share no particles and can be solved as a batch
+void ColorAngleConstraints(SoftBody &softBody)
+{
+    SoftBodyTemplate &topology = MutableTopology(softBody);
+    auto &constraints = topology.angleConstraints;
+    auto &offsets = topology.angleConstraintColors;
+    offsets.clear();
+    if (constraints.empty())
+        return;
+
+    std::vector<uint64_t> usedColors(softBody.pointMasses.positions.size(), 0);
+    std::vector<uint32_t> colors(constraints.size());
+    uint32_t colorCount = 0;
+
+    for (size_t i = 0; i < constraints.size(); ++i)
+    {
+        const auto &c = constraints[i];
+        uint64_t used = usedColors[c.i1] | usedColors[c.i2] | usedColors[c.i3];
+        uint32_t color = 0;
+        while (color < 63 && (used & (uint64_t(1) << color)))
+            ++color;
+
+        colors[i] = color;
+        colorCount = std::max(colorCount, color + 1);
+        usedColors[c.i1] |= uint64_t(1) << color;
+        usedColors[c.i2] |= uint64_t(1) << color;
+        usedColors[c.i3] |= uint64_t(1) << color;
+    }
+
+    std::vector<AngleConstraint> sorted;
+    sorted.reserve(constraints.size());
+    for (uint32_t color = 0; color < colorCount; ++color)
+    {
+        offsets.push_back(sorted.size());
+        for (size_t i = 0; i < constraints.size(); ++i)
+            if (colors[i] == color)
+                sorted.push_back(constraints[i]);
+    }
+    offsets.push_back(sorted.size());
+
+    constraints = std::move(sorted);
+}
+
+// newToOld[i] is the current index of the point that moves to slot i; every in-body index is remapped
+void PermutePoints(SoftBody &softBody, const std::vector<uint32_t> &newToOld)
+{
+    auto &pm = softBody.pointMasses;
+    size_t n = pm.positions.size();
+    if (newToOld.size() != n)
+        return;
+
+    std::vector<uint32_t> oldToNew(n);
+    for (uint32_t i = 0; i < n; ++i)
+        oldToNew[newToOld[i]] = i;
+
+    auto permute = [&](auto &values)
+    {
+        if (values.size() != n)
+            return;
+        auto old = values;
+        for (size_t i = 0; i < n; ++i)
+            values[i] = old[newToOld[i]];
+    };
+    permute(pm.positions);
+    permute(pm.prevPositions);
+    permute(pm.velocities);
+    permute(pm.inverseMasses);
+    permute(softBody.driveAccelerations);
+    permute(softBody.kinematicLocalPositions);
+
+    SoftBodyTemplate &topology = MutableTopology(softBody);
+    permute(topology.restState.positions);
+    permute(topology.restState.prevPositions);
+    permute(topology.restState.velocities);
+    permute(topology.restState.inverseMasses);
+
+    auto remap = [&](std::vector<uint32_t> &indices)
+    {
+        for (auto &index : indices)
+            index = oldToNew[index];
+    };
+
+    for (auto &c : topology.distanceConstraints)
+    {
+        c.i1 = oldToNew[c.i1];
+        c.i2 = oldToNew[c.i2];
+    }
+    for (auto &c : topology.angleConstraints)
+    {
+        c.i1 = oldToNew[c.i1];
+        c.i2 = oldToNew[c.i2];
+        c.i3 = oldToNew[c.i3];
+    }
+    for (auto &c : topology.pinConstraints)
+        c.index = oldToNew[c.index];
+    remap(topology.constraintIndices);
+    remap(topology.collisionPoints);
+    remap(topology.collisionShape);
+    remap(softBody.driveIndices);
+
+    if (topology.pointRemap.empty())
+        topology.pointRemap = oldToNew;
+    else
+        remap(topology.pointRemap);
+
+    topology.restState.partitioned = false;
+    pm.partitioned = false;
+}
+
+void PartitionPointMasses(SoftBody &softBody)
+{
+    auto &pm = softBody.pointMasses;
+    std::vector<uint32_t> newToOld;
+    newToOld.reserve(pm.positions.size());
+
+    for (uint32_t i = 0; i < pm.inverseMasses.size(); ++i)
+        if (pm.inverseMasses[i] != 0.0f)
+            newToOld.push_back(i);
+    size_t dynamicCount = newToOld.size();
+    for (uint32_t i = 0; i < pm.inverseMasses.size(); ++i)
+        if (pm.inverseMasses[i] == 0.0f)
+            newToOld.push_back(i);
+
+    bool identity = true;
+    for (uint32_t i = 0; i < newToOld.size(); ++i)
+        identity = identity && newToOld[i] == i;
+    if (!identity)
+        PermutePoints(softBody, newToOld);
+
+    pm.dynamicCount = dynamicCount;
+    pm.partitioned = true;
+
+    SoftBodyTemplate &topology = MutableTopology(softBody);
+    if (topology.restState.positions.size() == pm.positions.size())
+    {
+        topology.restState.dynamicCount = dynamicCount;
+        topology.restState.partitioned = true;
+    }
+}
+
+// reverse Cuthill-McKee over the constraint graph, then constraints sorted by their first point.
+// Sorted distance constraints are interleaved from 4 chunks so neighbours in the solve order
+// rarely share a point (back-to-back writes to one point serialize the Gauss-Seidel sweep).
+void ReorderPointsForLocality(SoftBody &softBody)
+{
+    auto &pm = softBody.pointMasses;
+    size_t n = pm.positions.size();
+    if (n < 3)
+        return;
+
+    const SoftBodyTemplate &topology = *softBody.topology;
+
+    std::vector<std::vector<uint32_t>> adjacency(n);
+    auto link = [&](uint32_t a, uint32_t b)
+    {
+        if (a == b)
+            return;
+        adjacency[a].push_back(b);
+        adjacency[b].push_back(a);
+    };
+    for (const auto &c : topology.distanceConstraints)
+        link(c.i1, c.i2);
+    for (const auto &c : topology.angleConstraints)
+    {
+        link(c.i1, c.i2);
+        link(c.i2, c.i3);
+    }
+    for (const auto &c : topology.volumeConstraints)
+    {
+        const uint32_t *indices = topology.constraintIndices.data() + c.indices.begin;
+        for (size_t i = 0; i < c.indices.count; ++i)
+            link(indices[i], indices[i + 1 < c.indices.count ? i + 1 : 0]);
+    }
+
+    for (auto &neighbours : adjacency)
+    {
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+    }
+    auto byDegree = [&](uint32_t a, uint32_t b)
+    {
+        return adjacency[a].size() != adjacency[b].size() ? adjacency[a].size() < adjacency[b].size() : a < b;
+    };
+    for (auto &neighbours : adjacency)
+        std::sort(neighbours.begin(), neighbours.end(), byDegree);
+
+    std::vector<uint32_t> byDegreeOrder(n);
+    for (uint32_t i = 0; i < n; ++i)
+        byDegreeOrder[i] = i;
+    std::sort(byDegreeOrder.begin(), byDegreeOrder.end(), byDegree);
+
+    std::vector<uint32_t> order;
+    order.reserve(n);
+    std::vector<bool> visited(n, false);
+    for (uint32_t start : byDegreeOrder)
+    {
+        if (visited[start])
+            continue;
+        visited[start] = true;
+        size_t head = order.size();
+        order.push_back(start);
+        while (head < order.size())
+        {
+            uint32_t current = order[head++];
+            for (uint32_t next : adjacency[current])
+            {
+                if (!visited[next])
+                {
+                    visited[next] = true;
+                    order.push_back(next);
+                }
+            }
+        }
+    }
+    std::reverse(order.begin(), order.end());
+
+    PermutePoints(softBody, order);
+
+    SoftBodyTemplate &sorted = MutableTopology(softBody);
+
+    std::stable_sort(sorted.distanceConstraints.begin(), sorted.distanceConstraints.end(),
+                     [](const DistanceConstraint &a, const DistanceConstraint &b)
+                     {
+                         return std::min(a.i1, a.i2) < std::min(b.i1, b.i2);
+                     });
+    {
+        const size_t chunks = 4;
+        auto &constraints = sorted.distanceConstraints;
+        size_t count = constraints.size();
+        size_t chunkSize = (count + chunks - 1) / chunks;
+        std::vector<DistanceConstraint> interleaved;
+        interleaved.reserve(count);
+        for (size_t i = 0; i < chunkSize; ++i)
+            for (size_t k = 0; k < chunks; ++k)
+                if (k * chunkSize + i < count)
+                    interleaved.push_back(constraints[k * chunkSize + i]);
+        constraints = std::move(interleaved);
+    }
+    std::stable_sort(sorted.angleConstraints.begin(), sorted.angleConstraints.end(),
+                     [](const AngleConstraint &a, const AngleConstraint &b)
+                     {
+                         return a.i2 < b.i2;
+                     });
+    ColorAngleConstraints(softBody);
+
+    PartitionPointMasses(softBody);
+}
+
+uint32_t RemapPointIndex(const SoftBody &softBody, uint32_t originalIndex)
+{
+    const auto &pointRemap = softBody.topology->pointRemap;
+    return pointRemap.empty() ? originalIndex : pointRemap[originalIndex];
+}
+
+void MakeStatic(SoftBody &softBody)
+{
+    softBody.type = BodyType::Static;
+    auto &pm = softBody.pointMasses;
+    std::fill(pm.inverseMasses.begin(), pm.inverseMasses.end(), 0.0f);
+    std::fill(pm.velocities.begin(), pm.velocities.end(), glm::vec2(0.0f));
+    pm.prevPositions = pm.positions;
+    pm.partitioned = true;
+    pm.dynamicCount = 0;
+    softBody.staticEdgeGrid = nullptr;
+}
+
+void MakeKinematic(SoftBody &softBody)
 {
-    for (auto &c : softBody.distanceConstraints)
-        c.lambda = 0.0f;
+    softBody.type = BodyType::Kinematic;
+    auto &pm = softBody.pointMasses;
+    std::fill(pm.inverseMasses.begin(), pm.inverseMasses.end(), 0.0f);
+    std::fill(pm.velocities.begin(), pm.velocities.end(), glm::vec2(0.0f));
+    pm.prevPositions = pm.positions;
+    pm.partitioned = true;
+    pm.dynamicCount = 0;
 
-    for (auto &c : softBody.volumeConstraints)
-        c.lambda = 0.0f;
+    glm::vec2 center = ComputeGeometryCenter(pm.positions);
+    softBody.kinematicLocalPositions.clear();
+    for (const auto &p : pm.positions)
+        softBody.kinematicLocalPositions.push_back(p - center);
 
-    for (auto &c : softBody.angleConstraints)
-        c.lambda = 0.0f;
+    softBody.kinematicTransform.position = center;
+    softBody.kinematicTransform.angle = 0.0f;
+    softBody.kinematicTarget = softBody.kinematicTransform;
+}
 
-    for (auto &c : softBody.shapeMatchingConstraints)
-        c.lambda = 0.0f;
+void ResetConstrainsLambdas(SoftBody &softBody)
+{
+    const SoftBodyTemplate &topology = *softBody.topology;
+    auto &lambdas = softBody.lambdas;
 
-    for (auto &c : softBody.pinConstraints)
-        c.lambda = 0.0f;
+    lambdas.distance.assign(topology.distanceConstraints.size(), 0.0f);
+    lambdas.volume.assign(topology.volumeConstraints.size(), 0.0f);
+    lambdas.angle.assign(topology.angleConstraints.size(), 0.0f);
+    lambdas.shapeMatching.assign(topology.shapeMatchingConstraints.size(), 0.0f);
+    lambdas.pin.assign(topology.pinConstraints.size(), 0.0f);
 }
 
 float ComputePolygonArea(const std::vector<glm::vec2> &positions, const std::vector<uint32_t> &indices)
@@ -101,7 +470,7 @@ glm::vec2 ComputeMassCenter(const std::vector<glm::vec2> &positions, const std::
 std::vector<RayHit> RaycastAllIntersections(const glm::vec2 &origin, const glm::vec2 &direction, SoftBody &body)
 {
     std::vector<RayHit> hits;
-    const auto &shape = body.collisionShape;
+    const auto &shape = body.topology->collisionShape;
     const auto &positions = body.pointMasses.positions;
 
     for (size_t i = 0; i < shape.size(); ++i)
@@ -116,7 +485,7 @@ std::vector<RayHit> RaycastAllIntersections(const glm::vec2 &origin, const glm::
             continue;
 
         float t = glm::dot(origin - p1, normal) / denom;
-        float u = Cross2D(origin - p1, edge) / Cross2D(direction, edge);
+        float u = Cross2D(p1 - origin, edge) / Cross2D(direction, edge);
 
         if (u >= 0 && t >= 0 && t <= 1)
         {
@@ -133,20 +502,32 @@ std::vector<RayHit> RaycastAllIntersections(const glm::vec2 &origin, const glm::
 
 std::optional<RayHit> RaycastFirstIntersection(const glm::vec2 &origin, const glm::vec2 &direction, SoftBody &body)
 {
-    auto hits = RaycastAllIntersections(origin, direction, body);
-    if (hits.empty())
-        return std::nullopt;
+    const auto &shape = body.topology->collisionShape;
+    const auto &positions = body.pointMasses.positions;
 
-    return *std::min_element(hits.begin(), hits.end(),
-                             [](const RayHit &a, const RayHit &b)
-                             {
-                                 return a.distance < b.distance;
-                             });
-}
+    std::optional<RayHit> first;
+    for (size_t i = 0; i < shape.size(); ++i)
+    {
+        glm::vec2 p1 = positions[shape[i]];
+        glm::vec2 edge = positions[shape[(i + 1) % shape.size()]] - p1;
+        float denom = Cross2D(direction, edge);
+        if (std::abs(denom) < 1e-6f)
+            continue;
 
+        float t = Cross2D(direction, origin - p1) / denom;
+        float u = Cross2D(p1 - origin, edge) / denom;
+        if (u >= 0 && t >= 0 && t <= 1 && (!first || u < first->distance))
+            first = RayHit{origin + direction * u, u, i};
+    }
+    return first;
+}
 
+bool CollisionFiltersMatch(const SoftBody &a, const SoftBody &b)
+{
+    return (a.collisionCategory & b.collisionMask) != 0 && (b.collisionCategory & a.collisionMask) != 0;
+}
 
-bool PointInPolygon(const glm::vec2 point, const std::vector<glm::vec2> positions)
+bool PointInPolygon(const glm::vec2 &point, const std::vector<glm::vec2> &positions)
 {
     int windingNumber = 0;
     size_t n = positions.size();
@@ -10,94 +10,165 @@ struct PointMasses
     std::vector<glm::vec2> prevPositions;
     std::vector<glm::vec2> velocities;
     std::vector<float> inverseMasses;
+
+    // set by PartitionPointMasses: [0, dynamicCount) have inverseMass > 0, the rest are pinned
+    bool partitioned = false;
+    size_t dynamicCount = 0;
 };
+
+// range of a variable-length constraint inside SoftBodyTemplate::constraintIndices
+// (or SoftBody::driveIndices for drives)
+struct IndexRange
+{
+    uint32_t begin = 0;
+    uint32_t count = 0;
+};
+
 struct DistanceConstraint
 {
     uint32_t i1, i2;
     float restDistance;
     float compliance = 0.0f;
-    float lambda = 0.0f;
 };
 struct VolumeConstraint
 {
-    std::vector<uint32_t> indices;
+    IndexRange indices;
     float restVolume;
     float compliance = 0.0f;
-    float lambda = 0.0f;
 };
 struct AngleConstraint
 {
     uint32_t i1, i2, i3;
-    float restAngle;
+    glm::vec2 restRotation; // (cos, sin) of the rest angle
     float compliance = 0.0f;
-    float lambda = 0.0f;
 };
 struct ShapeMatchingConstraint
 {
-    std::vector<uint32_t> indices;
-    std::vector<glm::vec2> startPositions;
+    IndexRange indices;
+    uint32_t restOffsetsBegin = 0; // indices.count entries in SoftBodyTemplate::constraintRestOffsets
+    glm::vec2 restCenter = glm::vec2(0.0f);
+    glm::mat2 restAqqInverse = glm::mat2(1.0f);
+    float linearity = 0.0f;
     float compliance = 0.0f;
-    float lambda = 0.0f;
 };
 struct PinConstraint
 {
     uint32_t index;
     glm::vec2 targetPosition;
     float compliance = 0.0f;
-    float lambda = 0.0f;
 };
 struct AccelerationConstraint
 {
-    std::vector<uint32_t> indices;
+    IndexRange indices;
     glm::vec2 acceleration;
 };
 struct ForceConstraint
 {
-    std::vector<uint32_t> indices;
+    IndexRange indices;
     glm::vec2 force;
 };
 struct VelocityConstraint
 {
-    std::vector<uint32_t> indices;
+    IndexRange indices;
     glm::vec2 velocity;
 };
 struct AngularAccelerationConstraint
 {
-    std::vector<uint32_t> indices;
+    IndexRange indices;
     float acceleration;
     glm::vec2 position;
 };
 struct AngularForceConstraint
 {
-    std::vector<uint32_t> indices;
+    IndexRange indices;
     float force;
     glm::vec2 position;
 };
 struct AngularVelocityConstraint
 {
-    std::vector<uint32_t> indices;
+    IndexRange indices;
     float velocity;
     glm::vec2 position;
 };
 
+enum class BodyType
+{
+    Dynamic,
+    Static,    // never moves, collides through a prebuilt StaticEdgeGrid
+    Kinematic, // follows kinematicTarget, never solved
+};
 
-struct SoftBody
+struct KinematicTransform
 {
-    PointMasses pointMasses;
+    glm::vec2 position = glm::vec2(0.0f);
+    float angle = 0.0f;
+};
+
+struct StaticEdgeGrid;
+struct SignedDistanceField;
+
+// immutable topology and rest data, shared by every instance spawned from it
+struct SoftBodyTemplate
+{
+    PointMasses restState;
     std::vector<DistanceConstraint> distanceConstraints;
     std::vector<VolumeConstraint> volumeConstraints;
     std::vector<AngleConstraint> angleConstraints;
+    std::vector<uint32_t> angleConstraintColors; // offsets of independent ranges in angleConstraints
     std::vector<ShapeMatchingConstraint> shapeMatchingConstraints;
     std::vector<PinConstraint> pinConstraints;
-    
+
+    // CSR pools shared by the variable-length constraints above
+    std::vector<uint32_t> constraintIndices;
+    std::vector<glm::vec2> constraintRestOffsets;
+
+    std::vector<uint32_t> collisionPoints;
+    std::vector<uint32_t> collisionShape;
+    std::vector<uint32_t> pointRemap; // original point index -> current one, empty while unpermuted
+    // optional collider for near-rigid bodies, baked from collisionShape; rebuild after editing it
+    std::shared_ptr<const SignedDistanceField> signedDistanceField;
+};
+
+struct ConstraintLambdas
+{
+    std::vector<float> distance;
+    std::vector<float> volume;
+    std::vector<float> angle;
+    std::vector<float> shapeMatching;
+    std::vector<float> pin;
+};
+
+struct SoftBody
+{
+    BodyType type = BodyType::Dynamic;
+    PointMasses pointMasses;
+    std::shared_ptr<const SoftBodyTemplate> topology = std::make_shared<SoftBodyTemplate>();
+    // the same template while this body builds it (see MutableTopology); null on spawned instances
+    std::shared_ptr<SoftBodyTemplate> buildingTopology;
+    ConstraintLambdas lambdas;
+
+    // two bodies collide only when each one's category bits are in the other's mask
+    uint32_t collisionCategory = 1;
+    uint32_t collisionMask = 0xffffffffu;
+    // dynamic bodies: collision points also collide with the body's own collisionShape
+    bool selfCollision = false;
+
     std::vector<AccelerationConstraint> accelerationConstraints;
     std::vector<ForceConstraint> forceConstraints;
     std::vector<VelocityConstraint> VelocityConstraints;
     std::vector<AngularAccelerationConstraint> angularAccelerationConstraints;
     std::vector<AngularForceConstraint> angularForceConstraints;
     std::vector<AngularVelocityConstraint> angularVelocityConstraints;
-    std::vector<uint32_t> collisionPoints;
-    std::vector<uint32_t> collisionShape;
+    std::vector<uint32_t> driveIndices;
+    std::vector<glm::vec2> driveAccelerations; // per point, filled by AccumulateDriveAccelerations
+
+    // static bodies; reset to nullptr after editing a static body's shape
+    std::shared_ptr<const StaticEdgeGrid> staticEdgeGrid;
+
+    // kinematic bodies: positions = kinematicTransform applied to kinematicLocalPositions
+    std::vector<glm::vec2> kinematicLocalPositions;
+    KinematicTransform kinematicTransform;
+    KinematicTransform kinematicTarget;
 };
 
 struct RayHit
@@ -113,6 +184,32 @@ DistanceConstraint CreateDistanceConstraint(const std::vector<glm::vec2> &positi
 AngleConstraint CreateAngleConstraint(const std::vector<glm::vec2> &positions, uint32_t i1, uint32_t i2, uint32_t i3, float compliance = 0.0f);
 AngleConstraint CreateAngleConstraint(const std::vector<glm::vec2> &positions, uint32_t i1, uint32_t i2, uint32_t i3, float compliance, float restAngle);
 
+SoftBodyTemplate &MutableTopology(SoftBody &softBody);
+std::shared_ptr<const SoftBodyTemplate> MakeSoftBodyTemplate(const SoftBody &softBody);
+SoftBody InstantiateSoftBody(const std::shared_ptr<const SoftBodyTemplate> &topology, const glm::vec2 &offset = glm::vec2(0.0f));
+
+// drops the entries of a template cache whose last instance is gone; the caller holds the cache's lock
+template <typename Cache>
+void PruneExpiredTemplates(Cache &templates)
+{
+    for (auto it = templates.begin(); it != templates.end();)
+        it = it->second.expired() ? templates.erase(it) : std::next(it);
+}
+
+IndexRange AppendConstraintIndices(SoftBody &softBody, const std::vector<uint32_t> &indices);
+IndexRange AppendDriveIndices(SoftBody &softBody, const std::vector<uint32_t> &indices);
+ShapeMatchingConstraint CreateShapeMatchingConstraint(SoftBody &softBody, const std::vector<uint32_t> &indices, const std::vector<glm::vec2> &startPositions, float compliance = 0.0f, float linearity = 0.0f);
+
+void ColorAngleConstraints(SoftBody &softBody);
+
+void PermutePoints(SoftBody &softBody, const std::vector<uint32_t> &newToOld);
+void PartitionPointMasses(SoftBody &softBody);
+void ReorderPointsForLocality(SoftBody &softBody);
+uint32_t RemapPointIndex(const SoftBody &softBody, uint32_t originalIndex);
+
+void MakeStatic(SoftBody &softBody);
+void MakeKinematic(SoftBody &softBody);
+
 void ResetConstrainsLambdas(SoftBody &softBody);
 
 float ComputePolygonArea(const std::vector<glm::vec2> &positions, const std::vector<uint32_t> &indices);
@@ -122,4 +219,6 @@ glm::vec2 ComputeMassCenter(const std::vector<glm::vec2> &positions, const std::
 std::vector<RayHit> RaycastAllIntersections(const glm::vec2 &origin, const glm::vec2 &direction, SoftBody &body);
 std::optional<RayHit> RaycastFirstIntersection(const glm::vec2 &origin, const glm::vec2 &direction, SoftBody &body);
 
-bool PointInPolygon(const glm::vec2 point, const std::vector<glm::vec2> positions);
\ No newline at end of file
+bool CollisionFiltersMatch(const SoftBody &a, const SoftBody &b);
+
+bool PointInPolygon(const glm::vec2 &point, const std::vector<glm::vec2> &positions);
\ No newline at end of file
@@ -0,0 +1,380 @@
+#include "soft_body_asset.hpp"
+#include "collision_system.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+enum AssetSection : uint32_t
+{
+    SectionPositions,
+    SectionInverseMasses,
+    SectionDistance,
+    SectionVolume,
+    SectionAngle,
+    SectionAngleColors,
+    SectionShapeMatching,
+    SectionPin,
+    SectionConstraintIndices,
+    SectionRestOffsets,
+    SectionCollisionPoints,
+    SectionCollisionShape,
+    SectionPointRemap,
+    SectionSignedDistanceField, // the field's cell size, empty without one; the field is rebaked on load
+    SectionCount
+};
+
+struct AssetArray
+{
+    uint64_t offset = 0; // from the start of the asset
+    uint64_t count = 0;  // elements
+};
+
+struct SoftBodyAssetHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t elementSizes[SectionCount]; // rejects assets written with a different struct layout
+    uint32_t partitioned;
+    uint32_t dynamicCount;
+    AssetArray arrays[SectionCount];
+};
+
+struct CarAssetHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t wheelSize;
+    uint32_t padding;
+    AssetArray wheels;
+    AssetArray bodyIndices;
+    AssetArray body; // embedded soft body asset, count in bytes
+};
+
+static const uint32_t SECTION_ELEMENT_SIZES[SectionCount] = {
+    sizeof(glm::vec2),
+    sizeof(float),
+    sizeof(DistanceConstraint),
+    sizeof(VolumeConstraint),
+    sizeof(AngleConstraint),
+    sizeof(uint32_t),
+    sizeof(ShapeMatchingConstraint),
+    sizeof(PinConstraint),
+    sizeof(uint32_t),
+    sizeof(glm::vec2),
+    sizeof(uint32_t),
+    sizeof(uint32_t),
+    sizeof(uint32_t),
+    sizeof(float),
+};
+
+// read-only view of a whole file
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &filename)
+    {
+#ifdef _WIN32
+        file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("Failed to open file: " + filename);
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        size = size_t(fileSize.QuadPart);
+        if (size == 0)
+            return;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+            data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Failed to open file: " + filename);
+        struct stat st;
+        if (fstat(fd, &st) == 0)
+            size = size_t(st.st_size);
+        if (size > 0)
+        {
+            void *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED)
+                data = static_cast<const char *>(view);
+        }
+        close(fd);
+#endif
+        if (size > 0 && !data)
+        {
+            Close();
+            throw std::runtime_error("Failed to map file: " + filename);
+        }
+    }
+
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data = nullptr;
+    size_t size = 0;
+
+private:
+    void Close()
+    {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data)
+            munmap(const_cast<char *>(data), size);
+#endif
+        data = nullptr;
+    }
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
+
+template <typename T>
+static AssetArray AppendArray(std::vector<char> &buffer, const std::vector<T> &values)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "asset arrays are stored raw");
+
+    buffer.resize((buffer.size() + 15) & ~size_t(15), 0);
+    AssetArray array;
+    array.offset = buffer.size();
+    array.count = values.size();
+    const char *bytes = reinterpret_cast<const char *>(values.data());
+    buffer.insert(buffer.end(), bytes, bytes + values.size() * sizeof(T));
+    return array;
+}
+
+template <typename T>
+static void ReadArray(const char *data, size_t size, const AssetArray &array, std::vector<T> &out)
+{
+    if (array.offset > size || array.count > (size - array.offset) / sizeof(T))
+        throw std::runtime_error("Corrupt asset: array out of bounds");
+
+    out.resize(size_t(array.count));
+    if (array.count > 0)
+        std::memcpy(out.data(), data + array.offset, size_t(array.count) * sizeof(T));
+}
+
+template <typename Header>
+static Header ReadHeader(const char *data, size_t size, uint32_t magic)
+{
+    Header header;
+    if (size < sizeof(Header))
+        throw std::runtime_error("Corrupt asset: truncated header");
+    std::memcpy(&header, data, sizeof(Header));
+    if (header.magic != magic)
+        throw std::runtime_error("Unexpected asset type");
+    if (header.version != ASSET_VERSION)
+        throw std::runtime_error("Unsupported asset version " + std::to_string(header.version));
+    return header;
+}
+
+static void WriteFile(const std::string &filename, const std::vector<char> &buffer)
+{
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open file: " + filename);
+    file.write(buffer.data(), std::streamsize(buffer.size()));
+    if (!file)
+        throw std::runtime_error("Failed to write file: " + filename);
+}
+
+static std::vector<char> SerializeSoftBody(const SoftBodyTemplate &topology)
+{
+    const PointMasses &rest = topology.restState;
+
+    SoftBodyAssetHeader header = {};
+    header.magic = SOFT_BODY_ASSET_MAGIC;
+    header.version = ASSET_VERSION;
+    std::memcpy(header.elementSizes, SECTION_ELEMENT_SIZES, sizeof(SECTION_ELEMENT_SIZES));
+    header.partitioned = rest.partitioned ? 1 : 0;
+    header.dynamicCount = uint32_t(rest.dynamicCount);
+
+    std::vector<char> buffer(sizeof(header), 0);
+    header.arrays[SectionPositions] = AppendArray(buffer, rest.positions);
+    header.arrays[SectionInverseMasses] = AppendArray(buffer, rest.inverseMasses);
+    header.arrays[SectionDistance] = AppendArray(buffer, topology.distanceConstraints);
+    header.arrays[SectionVolume] = AppendArray(buffer, topology.volumeConstraints);
+    header.arrays[SectionAngle] = AppendArray(buffer, topology.angleConstraints);
+    header.arrays[SectionAngleColors] = AppendArray(buffer, topology.angleConstraintColors);
+    header.arrays[SectionShapeMatching] = AppendArray(buffer, topology.shapeMatchingConstraints);
+    header.arrays[SectionPin] = AppendArray(buffer, topology.pinConstraints);
+    header.arrays[SectionConstraintIndices] = AppendArray(buffer, topology.constraintIndices);
+    header.arrays[SectionRestOffsets] = AppendArray(buffer, topology.constraintRestOffsets);
+    header.arrays[SectionCollisionPoints] = AppendArray(buffer, topology.collisionPoints);
+    header.arrays[SectionCollisionShape] = AppendArray(buffer, topology.collisionShape);
+    header.arrays[SectionPointRemap] = AppendArray(buffer, topology.pointRemap);
+    std::vector<float> fieldCellSize;
+    if (topology.signedDistanceField)
+        fieldCellSize.push_back(topology.signedDistanceField->cellSize);
+    header.arrays[SectionSignedDistanceField] = AppendArray(buffer, fieldCellSize);
+
+    std::memcpy(buffer.data(), &header, sizeof(header));
+    return buffer;
+}
+
+static bool RangeInPool(const IndexRange &range, size_t poolSize)
+{
+    return range.begin <= poolSize && range.count <= poolSize - range.begin;
+}
+
+// a corrupt asset must fail here rather than index out of bounds in the solver
+static void ValidateSoftBody(const SoftBodyTemplate &topology)
+{
+    size_t n = topology.restState.positions.size();
+    size_t poolSize = topology.constraintIndices.size();
+    bool valid = topology.restState.inverseMasses.size() == n &&
+                 topology.restState.dynamicCount <= n;
+
+    for (const auto &c : topology.distanceConstraints)
+        valid = valid && c.i1 < n && c.i2 < n;
+    for (const auto &c : topology.angleConstraints)
+        valid = valid && c.i1 < n && c.i2 < n && c.i3 < n;
+    for (const auto &c : topology.pinConstraints)
+        valid = valid && c.index < n;
+    for (const auto &c : topology.volumeConstraints)
+        valid = valid && RangeInPool(c.indices, poolSize);
+    for (const auto &c : topology.shapeMatchingConstraints)
+        valid = valid && RangeInPool(c.indices, poolSize) &&
+                RangeInPool(IndexRange{c.restOffsetsBegin, c.indices.count}, topology.constraintRestOffsets.size());
+    for (uint32_t index : topology.constraintIndices)
+        valid = valid && index < n;
+    for (uint32_t index : topology.collisionPoints)
+        valid = valid && index < n;
+    for (uint32_t index : topology.collisionShape)
+        valid = valid && index < n;
+    for (uint32_t index : topology.pointRemap)
+        valid = valid && index < n;
+    for (uint32_t offset : topology.angleConstraintColors)
+        valid = valid && offset <= topology.angleConstraints.size();
+
+    if (!valid)
+        throw std::runtime_error("Corrupt asset: index out of range");
+}
+
+static std::shared_ptr<const SoftBodyTemplate> DeserializeSoftBody(const char *data, size_t size)
+{
+    SoftBodyAssetHeader header = ReadHeader<SoftBodyAssetHeader>(data, size, SOFT_BODY_ASSET_MAGIC);
+    if (std::memcmp(header.elementSizes, SECTION_ELEMENT_SIZES, sizeof(SECTION_ELEMENT_SIZES)) != 0)
+        throw std::runtime_error("Asset was written with a different constraint layout");
+
+    auto topology = std::make_shared<SoftBodyTemplate>();
+    PointMasses &rest = topology->restState;
+    ReadArray(data, size, header.arrays[SectionPositions], rest.positions);
+    ReadArray(data, size, header.arrays[SectionInverseMasses], rest.inverseMasses);
+    ReadArray(data, size, header.arrays[SectionDistance], topology->distanceConstraints);
+    ReadArray(data, size, header.arrays[SectionVolume], topology->volumeConstraints);
+    ReadArray(data, size, header.arrays[SectionAngle], topology->angleConstraints);
+    ReadArray(data, size, header.arrays[SectionAngleColors], topology->angleConstraintColors);
+    ReadArray(data, size, header.arrays[SectionShapeMatching], topology->shapeMatchingConstraints);
+    ReadArray(data, size, header.arrays[SectionPin], topology->pinConstraints);
+    ReadArray(data, size, header.arrays[SectionConstraintIndices], topology->constraintIndices);
+    ReadArray(data, size, header.arrays[SectionRestOffsets], topology->constraintRestOffsets);
+    ReadArray(data, size, header.arrays[SectionCollisionPoints], topology->collisionPoints);
+    ReadArray(data, size, header.arrays[SectionCollisionShape], topology->collisionShape);
+    ReadArray(data, size, header.arrays[SectionPointRemap], topology->pointRemap);
+    std::vector<float> fieldCellSize;
+    ReadArray(data, size, header.arrays[SectionSignedDistanceField], fieldCellSize);
+
+    rest.prevPositions = rest.positions;
+    rest.velocities.assign(rest.positions.size(), glm::vec2(0.0f));
+    rest.partitioned = header.partitioned != 0;
+    rest.dynamicCount = header.dynamicCount;
+
+    ValidateSoftBody(*topology);
+    if (!fieldCellSize.empty())
+        topology->signedDistanceField = BuildSignedDistanceField(rest.positions, topology->collisionShape, fieldCellSize[0]);
+    return topology;
+}
+
+uint32_t PeekAssetMagic(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    uint32_t magic = 0;
+    if (!file.read(reinterpret_cast<char *>(&magic), sizeof(magic)))
+        return 0;
+    return magic;
+}
+
+void SaveSoftBodyAsset(const SoftBodyTemplate &topology, const std::string &filename)
+{
+    WriteFile(filename, SerializeSoftBody(topology));
+}
+
+std::shared_ptr<const SoftBodyTemplate> LoadSoftBodyAsset(const std::string &filename)
+{
+    MappedFile file(filename);
+    return DeserializeSoftBody(file.data, file.size);
+}
+
+void SaveCarAsset(const CarDefinition &car, const std::string &filename)
+{
+    if (!car.body)
+        throw std::runtime_error("Car has no body: " + filename);
+
+    CarAssetHeader header = {};
+    header.magic = CAR_ASSET_MAGIC;
+    header.version = ASSET_VERSION;
+    header.wheelSize = sizeof(WheelDefinition);
+
+    std::vector<char> buffer(sizeof(header), 0);
+    header.wheels = AppendArray(buffer, car.wheels);
+    header.bodyIndices = AppendArray(buffer, car.bodyIndices);
+    header.body = AppendArray(buffer, SerializeSoftBody(*car.body));
+
+    std::memcpy(buffer.data(), &header, sizeof(header));
+    WriteFile(filename, buffer);
+}
+
+CarDefinition LoadCarAsset(const std::string &filename)
+{
+    MappedFile file(filename);
+    CarAssetHeader header = ReadHeader<CarAssetHeader>(file.data, file.size, CAR_ASSET_MAGIC);
+    if (header.wheelSize != sizeof(WheelDefinition))
+        throw std::runtime_error("Asset was written with a different wheel layout: " + filename);
+    if (header.body.offset > file.size || header.body.count > file.size - header.body.offset)
+        throw std::runtime_error("Corrupt asset: array out of bounds");
+
+    CarDefinition car;
+    ReadArray(file.data, file.size, header.wheels, car.wheels);
+    ReadArray(file.data, file.size, header.bodyIndices, car.bodyIndices);
+    car.body = DeserializeSoftBody(file.data + header.body.offset, size_t(header.body.count));
+
+    for (const auto &wheel : car.wheels)
+    {
+        if (!RangeInPool(wheel.bodyIndices, car.bodyIndices.size()))
+            throw std::runtime_error("Corrupt asset: index out of range");
+    }
+    for (uint32_t index : car.bodyIndices)
+    {
+        size_t pointCount = car.body->pointRemap.empty() ? car.body->restState.positions.size() : car.body->pointRemap.size();
+        if (index >= pointCount)
+            throw std::runtime_error("Corrupt asset: index out of range");
+    }
+    return car;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "soft_body.hpp"
+#include "car.hpp"
+#include <string>
+#include <memory>
+
+// Binary assets: a fixed header followed by the template's arrays stored as-is (SoA, 16-byte aligned).
+// Produced offline from JSON by tools/asset_converter.cpp, loaded with one mmap and a memcpy per array.
+const uint32_t SOFT_BODY_ASSET_MAGIC = 0x59444253; // "SBDY"
+const uint32_t CAR_ASSET_MAGIC = 0x52414353;       // "SCAR"
+const uint32_t ASSET_VERSION = 2;
+
+// magic of a file, 0 when it is shorter than 4 bytes or can not be opened
+uint32_t PeekAssetMagic(const std::string &filename);
+
+void SaveSoftBodyAsset(const SoftBodyTemplate &topology, const std::string &filename);
+std::shared_ptr<const SoftBodyTemplate> LoadSoftBodyAsset(const std::string &filename);
+
+// the body template is embedded, so a car asset is self-contained
+void SaveCarAsset(const CarDefinition &car, const std::string &filename);
+CarDefinition LoadCarAsset(const std::string &filename);
@@ -1,17 +1,39 @@
 #pragma once
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include "json.hpp"
 #include <glm/glm.hpp>
 #include "soft_body.hpp"
 #include "shape_tools.hpp"
 #include "car.hpp"
+#include "soft_body_asset.hpp"
+#include "collision_system.hpp"
 
 using json = nlohmann::json;
 
-SoftBody LoadSoftBodyFromFile(const std::string &filename)
+// bodies loaded from the same file share one template while any instance is alive
+std::shared_ptr<const SoftBodyTemplate> LoadSoftBodyTemplateFromFile(const std::string &filename, bool reorderForLocality = true)
 {
+    static std::map<std::pair<std::string, bool>, std::weak_ptr<const SoftBodyTemplate>> templates;
+    static std::mutex templatesMutex;
+    std::lock_guard<std::mutex> lock(templatesMutex);
+    PruneExpiredTemplates(templates);
+    auto &cached = templates[{filename, reorderForLocality}];
+    if (auto shared = cached.lock())
+        return shared;
+
+    // binary assets are stored already reordered
+    if (PeekAssetMagic(filename) == SOFT_BODY_ASSET_MAGIC)
+    {
+        auto shared = LoadSoftBodyAsset(filename);
+        cached = shared;
+        return shared;
+    }
+
     SoftBody softBody;
+    SoftBodyTemplate &topology = MutableTopology(softBody);
 
     std::ifstream file(filename);
     if (!file.is_open())
@@ -43,7 +65,7 @@ SoftBody LoadSoftBodyFromFile(const std::string &filename)
             constraint = CreateDistanceConstraint(softBody.pointMasses.positions, dc["i1"], dc["i2"], compliance, dc["restDistance"]);
         else
             constraint = CreateDistanceConstraint(softBody.pointMasses.positions, dc["i1"], dc["i2"], compliance);
-        softBody.distanceConstraints.push_back(constraint);
+        topology.distanceConstraints.push_back(constraint);
     }
 
     // VolumeConstraints
@@ -52,11 +74,13 @@ SoftBody LoadSoftBodyFromFile(const std::string &filename)
         VolumeConstraint constraint;
 
         constraint.compliance = vc.value("compliance", 0.0f);
+        std::vector<uint32_t> indices;
         for (const auto &idx : vc["indices"])
-            constraint.indices.push_back(idx);
+            indices.push_back(idx);
 
-        constraint.restVolume = vc.value("restVolume", ComputePolygonArea(softBody.pointMasses.positions, constraint.indices));
-        softBody.volumeConstraints.push_back(constraint);
+        constraint.indices = AppendConstraintIndices(softBody, indices);
+        constraint.restVolume = vc.value("restVolume", ComputePolygonArea(softBody.pointMasses.positions, indices));
+        topology.volumeConstraints.push_back(constraint);
     }
 
     // AngleConstraints
@@ -68,30 +92,35 @@ SoftBody LoadSoftBodyFromFile(const std::string &filename)
             constraint = CreateAngleConstraint(softBody.pointMasses.positions, dc["i1"], dc["i2"], dc["i3"], compliance, dc["restAngle"]);
         else
             constraint = CreateAngleConstraint(softBody.pointMasses.positions, dc["i1"], dc["i2"], dc["i3"], compliance);
-        softBody.angleConstraints.push_back(constraint);
+        topology.angleConstraints.push_back(constraint);
     }
+    ColorAngleConstraints(softBody);
 
     // ShapeMatchingConstraints
     for (const auto &smc : j["shapeMatchingConstraints"])
     {
-        ShapeMatchingConstraint constraint;
-        constraint.compliance = smc.value("compliance", 0.0f);
-
+        std::vector<uint32_t> indices;
         for (const auto &idx : smc["indices"])
-            constraint.indices.push_back(idx);
+            indices.push_back(idx);
 
+        std::vector<glm::vec2> startPositions;
         if (smc.contains("startPositions"))
         {
             for (const auto &sp : smc["startPositions"])
-                constraint.startPositions.emplace_back(sp[0], sp[1]);
+                startPositions.emplace_back(sp[0], sp[1]);
         }
         else
         {
-            for (const auto index : constraint.indices)
-                constraint.startPositions.push_back(softBody.pointMasses.positions[index]);
+            for (const auto index : indices)
+                startPositions.push_back(softBody.pointMasses.positions[index]);
         }
 
-        softBody.shapeMatchingConstraints.push_back(constraint);
+        topology.shapeMatchingConstraints.push_back(CreateShapeMatchingConstraint(
+            softBody,
+            indices,
+            startPositions,
+            smc.value("compliance", 0.0f),
+            smc.value("linearity", 0.0f)));
     }
 
     // PinConstraints
@@ -101,7 +130,7 @@ SoftBody LoadSoftBodyFromFile(const std::string &filename)
         constraint.index = pc["index"];
         constraint.targetPosition = glm::vec2(pc["targetPosition"][0], pc["targetPosition"][1]);
         constraint.compliance = pc.value("compliance", 0.0f);
-        softBody.pinConstraints.push_back(constraint);
+        topology.pinConstraints.push_back(constraint);
     }
 
     // Collision data
@@ -109,24 +138,44 @@ SoftBody LoadSoftBodyFromFile(const std::string &filename)
     {
         for (const auto &idx : j["collisionPoints"])
         {
-            softBody.collisionPoints.push_back(idx);
+            topology.collisionPoints.push_back(idx);
         }
     }
     if (j.contains("collisionShape"))
     {
         for (const auto &idx : j["collisionShape"])
         {
-            softBody.collisionShape.push_back(idx);
+            topology.collisionShape.push_back(idx);
         }
     }
 
     softBody.pointMasses.prevPositions = softBody.pointMasses.positions;
+    if (reorderForLocality)
+        ReorderPointsForLocality(softBody);
+    else
+        PartitionPointMasses(softBody);
+
+    if (j.contains("signedDistanceField"))
+    {
+        float cellSize = j["signedDistanceField"].value("cellSize", 4.0f);
+        MutableTopology(softBody).signedDistanceField = BuildSignedDistanceField(softBody.pointMasses.positions, softBody.topology->collisionShape, cellSize);
+    }
 
-    return softBody;
+    auto shared = MakeSoftBodyTemplate(softBody);
+    cached = shared;
+    return shared;
 }
 
-Car LoadCarFromFile(const std::string &filename)
+SoftBody LoadSoftBodyFromFile(const std::string &filename, bool reorderForLocality = true)
+{
+    return InstantiateSoftBody(LoadSoftBodyTemplateFromFile(filename, reorderForLocality));
+}
+
+CarDefinition LoadCarDefinitionFromFile(const std::string &filename)
 {
+    if (PeekAssetMagic(filename) == CAR_ASSET_MAGIC)
+        return LoadCarAsset(filename);
+
     std::ifstream file(filename);
     if (!file.is_open())
         throw std::runtime_error("Failed to open car file: " + filename);
@@ -134,61 +183,79 @@ Car LoadCarFromFile(const std::string &filename)
     json j;
     file >> j;
 
+    CarDefinition car;
+    car.body = LoadSoftBodyTemplateFromFile(j["bodyFile"]);
+
+    for (const auto &w : j["wheels"])
+    {
+        WheelDefinition wheel;
+        wheel.position = glm::vec2(w["position"][0], w["position"][1]);
+        wheel.radius = w.value("radius", 50);
+        wheel.diskMass = w.value("diskMass", 10.0f);
+        wheel.tireMass = w.value("tireMass", 5.0f);
+        wheel.tireRatio = w.value("tireRatio", 0.5f);
+        wheel.diskHubCompliance = w.value("diskHubCompliance", 0.0f);
+        wheel.diskRimCompliance = w.value("diskRimCompliance", 0.0f);
+        wheel.tireBodyCompliance = w.value("tireBodyCompliance", 0.001f);
+        wheel.tireTreadCompliance = w.value("tireTreadCompliance", 0.001f);
+        wheel.tirePressureCompliance = w.value("tirePressureCompliance", 0.0f);
+        wheel.tirePressure = w.value("tirePressure", 1.0f);
+        wheel.segments = w.value("segments", 3);
+        wheel.jointCompliance = w.value("jointCompliance", 0.0f);
+
+        std::vector<uint32_t> bodyIndices;
+        for (const auto &i : w["bodyIndices"])
+            bodyIndices.push_back(i.get<uint32_t>());
+        wheel.bodyIndices.begin = uint32_t(car.bodyIndices.size());
+        wheel.bodyIndices.count = uint32_t(bodyIndices.size());
+        car.bodyIndices.insert(car.bodyIndices.end(), bodyIndices.begin(), bodyIndices.end());
+
+        car.wheels.push_back(wheel);
+    }
+
+    return car;
+}
+
+Car BuildCar(const CarDefinition &definition)
+{
     Car car;
 
-    // Load body
-    std::shared_ptr<SoftBody> bodyPtr = std::make_shared<SoftBody>(LoadSoftBodyFromFile(j["bodyFile"]));
+    std::shared_ptr<SoftBody> bodyPtr = std::make_shared<SoftBody>(InstantiateSoftBody(definition.body));
     car.body = bodyPtr;
 
-    const auto &wheelDefs = j["wheels"];
-    for (const auto &w : wheelDefs)
+    for (const auto &w : definition.wheels)
     {
-        glm::vec2 position(w["position"][0], w["position"][1]);
-        float radius = w.value("radius", 50);
-        float diskMass = w.value("diskMass", 10.0f);
-        float tireMass = w.value("tireMass", 5.0f);
-        float tireRatio = w.value("tireRatio", 0.5f);
-        float diskHubCompliance = w.value("diskHubCompliance", 0.0f);
-        float diskRimCompliance = w.value("diskRimCompliance", 0.0f);
-        float tireBodyCompliance = w.value("tireBodyCompliance", 0.001f);
-        float tireTreadCompliance = w.value("tireTreadCompliance", 0.001f);
-        float tirePressureCompliance = w.value("tirePressureCompliance", 0.0f);
-        float tirePressure = w.value("tirePressure", 1.0f);
-        int segments = w.value("segments", 3);
-
         SoftBody wheel = CreateWheel(
-            position,
-            radius,
-            diskMass,
-            tireMass,
-            tireRatio,
-            diskHubCompliance,
-            diskRimCompliance,
-            tireBodyCompliance,
-            tireTreadCompliance,
-            tirePressureCompliance,
-            tirePressure,
-            segments);
+            w.position,
+            w.radius,
+            w.diskMass,
+            w.tireMass,
+            w.tireRatio,
+            w.diskHubCompliance,
+            w.diskRimCompliance,
+            w.tireBodyCompliance,
+            w.tireTreadCompliance,
+            w.tirePressureCompliance,
+            w.tirePressure,
+            w.segments);
 
         std::shared_ptr<SoftBody> wheelPtr = std::make_shared<SoftBody>(std::move(wheel));
         car.wheels.push_back(wheelPtr);
 
-        const auto &bodyIndices = w["bodyIndices"];
-        const auto &jointCompliance = w.value("jointCompliance", 0.0f);
-        for (const auto &i : bodyIndices)
+        for (uint32_t k = 0; k < w.bodyIndices.count; ++k)
         {
             auto djPtr = std::make_shared<DistanceJoint>();
             djPtr->softBody1 = wheelPtr;
             djPtr->softBody2 = bodyPtr;
-            uint32_t bodyIndex = i.get<uint32_t>();
-            djPtr->index1 = 0;
+            uint32_t bodyIndex = RemapPointIndex(*bodyPtr, definition.bodyIndices[w.bodyIndices.begin + k]);
+            djPtr->index1 = RemapPointIndex(*wheelPtr, 0);
             djPtr->index2 = bodyIndex;
 
-            const glm::vec2 &p1 = wheelPtr->pointMasses.positions[0];
+            const glm::vec2 &p1 = wheelPtr->pointMasses.positions[djPtr->index1];
             const glm::vec2 &p2 = bodyPtr->pointMasses.positions[bodyIndex];
             float restDistance = glm::length(p1 - p2);
             djPtr->restDistance = restDistance;
-            djPtr->compliance = jointCompliance;
+            djPtr->compliance = w.jointCompliance;
             djPtr->lambda = 0.0f;
             car.distanceJoints.push_back(djPtr);
         }
@@ -225,3 +292,8 @@ Car LoadCarFromFile(const std::string &filename)
 
     return car;
 }
+
+Car LoadCarFromFile(const std::string &filename)
+{
+    return BuildCar(LoadCarDefinitionFromFile(filename));
+}
@@ -32,6 +32,20 @@ inline float CalculateAngle(glm::vec2 p1, glm::vec2 p2, glm::vec2 p3)
 
     return angle;
 }
+// polynomial atan2, max error ~2e-4 rad, branches compile to selects
+inline float FastAtan2(float y, float x)
+{
+    float ax = std::abs(x);
+    float ay = std::abs(y);
+    float mx = std::max(ax, ay);
+    float mn = std::min(ax, ay);
+    float a = mn / (mx > 0.0f ? mx : 1.0f);
+    float s = a * a;
+    float r = ((-0.0464964749f * s + 0.15931422f) * s - 0.327622764f) * s * a + a;
+    r = ay > ax ? 1.57079637f - r : r;
+    r = x < 0.0f ? 3.14159274f - r : r;
+    return y < 0.0f ? -r : r;
+}
 inline float OrientedAngle2D(const glm::vec2& a, const glm::vec2& b)
 {
     float angle = glm::acos(glm::clamp(glm::dot(glm::normalize(a), glm::normalize(b)), -1.0f, 1.0f));
@@ -0,0 +1,53 @@
+// Offline converter from the JSON soft body / car descriptions to the binary asset format.
+//   asset_converter <input.json> <output>
+// A file with "bodyFile" is converted as a car (the body is embedded), anything else as a soft body.
+// Build together with the simulation sources; renderer.cpp and SFML are needed because joint_system.cpp
+// calls Renderer::Draw*, e.g.
+//   g++ -std=c++17 -O2 -I../include -I../include/nlohmann -I../src asset_converter.cpp ../src/soft_body.cpp ../src/soft_body_asset.cpp ../src/shape_tools.cpp ../src/collision_system.cpp ../src/joint_system.cpp
+//       ../src/renderer.cpp -lsfml-graphics -lsfml-window -lsfml-system
+
+#include "soft_body_loader.hpp"
+#include "soft_body_asset.hpp"
+
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        std::cerr << "usage: " << argv[0] << " <input.json> <output>" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        std::ifstream file(argv[1]);
+        if (!file.is_open())
+            throw std::runtime_error(std::string("Failed to open file: ") + argv[1]);
+        json j;
+        file >> j;
+
+        if (j.contains("bodyFile"))
+        {
+            CarDefinition car = LoadCarDefinitionFromFile(argv[1]);
+            SaveCarAsset(car, argv[2]);
+            std::cout << "car: " << car.wheels.size() << " wheels, "
+                      << car.body->restState.positions.size() << " body points" << std::endl;
+        }
+        else
+        {
+            auto topology = LoadSoftBodyTemplateFromFile(argv[1]);
+            SaveSoftBodyAsset(*topology, argv[2]);
+            std::cout << "soft body: " << topology->restState.positions.size() << " points, "
+                      << topology->distanceConstraints.size() << " distance, "
+                      << topology->angleConstraints.size() << " angle constraints" << std::endl;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}